@@ -0,0 +1,655 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <new>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+#include "./src/ConcavePolygon.h"
+#include "./src/ParallelDecomposition.h"
+
+using namespace cxd;
+
+// Heap accounting: every allocation carries its size in a small header so
+// the benchmark can report the peak heap use of each case on its own.
+namespace
+{
+
+const std::size_t HEADER_SIZE = 16;
+
+std::atomic<long long> currentHeapBytes{0};
+std::atomic<long long> peakHeapBytes{0};
+
+void countAlloc(std::size_t size)
+{
+    long long current = currentHeapBytes.fetch_add(size) + size;
+    long long peak = peakHeapBytes.load();
+    while(current > peak && !peakHeapBytes.compare_exchange_weak(peak, current)) {}
+}
+
+void * countedAlloc(std::size_t size)
+{
+    void * block = std::malloc(size + HEADER_SIZE);
+    if(block == nullptr)
+        return nullptr;
+
+    *static_cast<std::size_t *>(block) = size;
+    countAlloc(size);
+
+    return static_cast<char *>(block) + HEADER_SIZE;
+}
+
+void countedFree(void * ptr)
+{
+    if(ptr == nullptr)
+        return;
+
+    void * block = static_cast<char *>(ptr) - HEADER_SIZE;
+    currentHeapBytes.fetch_sub(*static_cast<std::size_t *>(block));
+    std::free(block);
+}
+
+// Over aligned types such as BasicPieceProperties: the header holds the
+// size and the start of the malloc block, which the returned pointer is
+// aligned inside of
+void * countedAlignedAlloc(std::size_t size, std::size_t alignment)
+{
+    void * block = std::malloc(size + HEADER_SIZE + alignment);
+    if(block == nullptr)
+        return nullptr;
+
+    std::uintptr_t start = (reinterpret_cast<std::uintptr_t>(block) + HEADER_SIZE + alignment - 1) &
+                           ~static_cast<std::uintptr_t>(alignment - 1);
+    char * ptr = reinterpret_cast<char *>(start);
+
+    std::memcpy(ptr - HEADER_SIZE, &size, sizeof(size));
+    std::memcpy(ptr - HEADER_SIZE + sizeof(size), &block, sizeof(block));
+    countAlloc(size);
+
+    return ptr;
+}
+
+void countedAlignedFree(void * ptr)
+{
+    if(ptr == nullptr)
+        return;
+
+    std::size_t size;
+    void * block;
+    std::memcpy(&size, static_cast<char *>(ptr) - HEADER_SIZE, sizeof(size));
+    std::memcpy(&block, static_cast<char *>(ptr) - HEADER_SIZE + sizeof(size), sizeof(block));
+    currentHeapBytes.fetch_sub(size);
+    std::free(block);
+}
+
+void resetPeakHeap()
+{
+    peakHeapBytes.store(currentHeapBytes.load());
+}
+
+}
+
+void * operator new(std::size_t size)
+{
+    if(void * ptr = countedAlloc(size))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void * operator new(std::size_t size, std::nothrow_t const &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void * operator new[](std::size_t size, std::nothrow_t const &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void operator delete(void * ptr) noexcept { countedFree(ptr); }
+void operator delete[](void * ptr) noexcept { countedFree(ptr); }
+void operator delete(void * ptr, std::size_t) noexcept { countedFree(ptr); }
+void operator delete[](void * ptr, std::size_t) noexcept { countedFree(ptr); }
+void operator delete(void * ptr, std::nothrow_t const &) noexcept { countedFree(ptr); }
+void operator delete[](void * ptr, std::nothrow_t const &) noexcept { countedFree(ptr); }
+
+void * operator new(std::size_t size, std::align_val_t alignment)
+{
+    if(void * ptr = countedAlignedAlloc(size, static_cast<std::size_t>(alignment)))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment, std::nothrow_t const &) noexcept
+{
+    return countedAlignedAlloc(size, static_cast<std::size_t>(alignment));
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment, std::nothrow_t const &) noexcept
+{
+    return countedAlignedAlloc(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void * ptr, std::align_val_t) noexcept { countedAlignedFree(ptr); }
+void operator delete[](void * ptr, std::align_val_t) noexcept { countedAlignedFree(ptr); }
+void operator delete(void * ptr, std::size_t, std::align_val_t) noexcept { countedAlignedFree(ptr); }
+void operator delete[](void * ptr, std::size_t, std::align_val_t) noexcept { countedAlignedFree(ptr); }
+void operator delete(void * ptr, std::align_val_t, std::nothrow_t const &) noexcept { countedAlignedFree(ptr); }
+void operator delete[](void * ptr, std::align_val_t, std::nothrow_t const &) noexcept { countedAlignedFree(ptr); }
+
+long getMaxRssKb()
+{
+#ifdef __unix__
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss;
+#endif
+    return -1;
+}
+
+// Polygon families. Every generator returns a simple polygon with exactly
+// n vertices (n >= 10).
+
+const double PI = 3.14159265358979323846;
+
+std::vector<Vertex > generateStar(int n)
+{
+    std::vector<Vertex > verts;
+    for(int i=0; i<n; ++i)
+    {
+        double angle = 2.0 * PI * i / n;
+        double radius = (i % 2 == 0) ? 1.0 : 0.5;
+        verts.push_back(Vertex({radius * std::cos(angle), radius * std::sin(angle)}));
+    }
+    return verts;
+}
+
+// A band wound into a spiral: out along the outer arm, back along the inner
+std::vector<Vertex > generateSpiral(int n)
+{
+    int armVerts = n / 2;
+    double turns = 3.0;
+    double width = 0.35;
+
+    std::vector<Vertex > verts;
+    for(int i=0; i<armVerts; ++i)
+    {
+        double t = (double)i / (armVerts - 1);
+        double angle = 2.0 * PI * turns * t;
+        double radius = 1.0 + t * turns;
+        verts.push_back(Vertex({radius * std::cos(angle), radius * std::sin(angle)}));
+    }
+    for(int i=n-armVerts-1; i>=0; --i)
+    {
+        double t = (double)i / (n - armVerts - 1);
+        double angle = 2.0 * PI * turns * t;
+        double radius = 1.0 + t * turns - width;
+        verts.push_back(Vertex({radius * std::cos(angle), radius * std::sin(angle)}));
+    }
+    return verts;
+}
+
+// A bar with rectangular teeth along its top; each tooth takes 4 vertices.
+// Like the other families it spans roughly a unit box.
+std::vector<Vertex > generateComb(int n)
+{
+    int teeth = (n - 2) / 4;
+    int extra = (n - 2) - teeth * 4;
+    double pitch = 1.0 / teeth;
+
+    std::vector<Vertex > verts;
+    verts.push_back(Vertex({-0.1, -0.1}));
+    verts.push_back(Vertex({1.0, -0.1}));
+
+    for(int i=teeth-1; i>=0; --i)
+    {
+        double x = i * pitch;
+        verts.push_back(Vertex({x + pitch, 0.0}));
+        verts.push_back(Vertex({x + 0.75 * pitch, 0.0}));
+        verts.push_back(Vertex({x + 0.75 * pitch, 0.3}));
+        verts.push_back(Vertex({x + 0.25 * pitch, 0.3}));
+    }
+    for(int i=0; i<extra; ++i)
+        verts.push_back(Vertex({0.2 * pitch - 0.1 * pitch * i, 0.0}));
+
+    return verts;
+}
+
+// A strip whose top edge is a noisy zig-zag, like a traced coastline
+std::vector<Vertex > generateCoastline(int n)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> noise(0.2, 1.0);
+
+    std::vector<Vertex > verts;
+    double spacing = 1.0 / (n - 3);
+
+    verts.push_back(Vertex({0.0, -0.3}));
+    verts.push_back(Vertex({1.0, -0.3}));
+
+    for(int i=n-3; i>=0; --i)
+    {
+        double height = (i % 2 == 0) ? noise(rng) : -0.5 * noise(rng);
+        verts.push_back(Vertex({i * spacing, 0.3 * height}));
+    }
+    return verts;
+}
+
+// Star-shaped polygon with random radii at sorted random angles
+std::vector<Vertex > generateRandom(int n)
+{
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<double> angleDist(0.0, 2.0 * PI);
+    std::uniform_real_distribution<double> radiusDist(0.3, 1.0);
+
+    std::vector<double > angles(n);
+    for(int i=0; i<n; ++i)
+        angles[i] = angleDist(rng);
+    std::sort(angles.begin(), angles.end());
+
+    std::vector<Vertex > verts;
+    for(int i=0; i<n; ++i)
+    {
+        double radius = radiusDist(rng);
+        verts.push_back(Vertex({radius * std::cos(angles[i]), radius * std::sin(angles[i])}));
+    }
+    return verts;
+}
+
+struct Family
+{
+    const char * name;
+    std::vector<Vertex > (*generate)(int);
+};
+
+const Family FAMILIES[] =
+{
+    {"star", generateStar},
+    {"spiral", generateSpiral},
+    {"comb", generateComb},
+    {"coastline", generateCoastline},
+    {"random", generateRandom}
+};
+
+// Horizontal cuts spread over the polygon's bounding box
+std::vector<LineSegment > generateCuts(std::vector<Vertex > const & verts, int numCuts)
+{
+    Vec2 minBounds = verts[0].position;
+    Vec2 maxBounds = verts[0].position;
+    for(auto const & vert : verts)
+    {
+        minBounds = {std::min(minBounds.x, vert.position.x), std::min(minBounds.y, vert.position.y)};
+        maxBounds = {std::max(maxBounds.x, vert.position.x), std::max(maxBounds.y, vert.position.y)};
+    }
+
+    Vec2 extent = maxBounds - minBounds;
+    std::vector<LineSegment > cuts;
+    for(int i=0; i<numCuts; ++i)
+    {
+        double y = minBounds.y + extent.y * (i + 0.5) / numCuts;
+        double tilt = extent.y * 0.01 * (i % 3 - 1);
+        cuts.push_back(LineSegment({minBounds.x - extent.x, y - tilt},
+                                   {maxBounds.x + extent.x, y + tilt}));
+    }
+    return cuts;
+}
+
+struct Settings
+{
+    std::vector<int > sizes;
+    std::vector<std::string > families;
+    std::vector<std::string > operations;
+    double minSeconds;
+    int maxRepetitions;
+    unsigned int threads;
+    bool csv;
+    bool useFloat;
+    DecompOptions options;
+};
+
+struct Measurement
+{
+    double nanoseconds;
+    int pieces;
+    long long peakHeap;
+    int repetitions;
+};
+
+// Runs the case repeatedly until minSeconds have passed and reports the
+// fastest run. setup() is excluded from the timing, body() returns the
+// number of pieces produced.
+template<typename Setup, typename Body>
+Measurement measure(Settings const & settings, Setup const & setup, Body const & body)
+{
+    Measurement result = {0.0, 0, 0, 0};
+    double totalSeconds = 0.0;
+
+    while(result.repetitions < settings.maxRepetitions &&
+          (result.repetitions == 0 || totalSeconds < settings.minSeconds))
+    {
+        auto state = setup();
+
+        long long heapBefore = currentHeapBytes.load();
+        resetPeakHeap();
+
+        auto start = std::chrono::steady_clock::now();
+        int pieces = body(state);
+        auto end = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(end - start).count();
+        double nanoseconds = seconds * 1e9;
+
+        if(result.repetitions == 0 || nanoseconds < result.nanoseconds)
+            result.nanoseconds = nanoseconds;
+        result.pieces = pieces;
+        result.peakHeap = std::max(result.peakHeap, peakHeapBytes.load() - heapBefore);
+
+        totalSeconds += seconds;
+        ++result.repetitions;
+    }
+
+    return result;
+}
+
+template<typename Scalar>
+BasicVec2<Scalar> convertPoint(Vec2 const & point)
+{
+    return {(Scalar)point.x, (Scalar)point.y};
+}
+
+template<typename Scalar>
+int countLeaves(BasicConcavePolygon<Scalar> const & poly)
+{
+    BasicConvexDecomposition<Scalar> leaves;
+    poly.returnLowestLevelPolys(leaves);
+    return leaves.getNumberPieces();
+}
+
+template<typename Scalar>
+Measurement runOperation(Settings const & settings,
+                         std::string const & operation,
+                         std::vector<Vertex > const & generated)
+{
+    typedef BasicConcavePolygon<Scalar> ConcavePolygon;
+    typedef BasicConvexDecomposition<Scalar> ConvexDecomposition;
+    typedef BasicPhysicsDecomposition<Scalar> PhysicsDecomposition;
+
+    DecompOptions const & options = settings.options;
+
+    std::vector<BasicVertex<Scalar> > verts;
+    for(auto const & vert : generated)
+        verts.push_back(BasicVertex<Scalar>(convertPoint<Scalar>(vert.position)));
+
+    std::vector<BasicLineSegment<Scalar> > cuts;
+    for(auto const & cut : generateCuts(generated, 16))
+        cuts.push_back(BasicLineSegment<Scalar>(convertPoint<Scalar>(cut.startPos),
+                                                convertPoint<Scalar>(cut.finalPos)));
+
+    if(operation == "decomp_tree")
+    {
+        return measure(settings, [&]() { return ConcavePolygon(verts); },
+                       [&](ConcavePolygon & poly)
+        {
+            poly.convexDecomp(options);
+            return countLeaves(poly);
+        });
+    }
+    else if(operation == "decomp_arena")
+    {
+        ConcavePolygon poly(verts);
+        return measure(settings, [&]() { return ConvexDecomposition(); },
+                       [&](ConvexDecomposition & result)
+        {
+            poly.convexDecomp(result, options);
+            return result.getNumberPieces();
+        });
+    }
+    else if(operation == "decomp_physics")
+    {
+        ConcavePolygon poly(verts);
+        return measure(settings, [&]() { return PhysicsDecomposition(); },
+                       [&](PhysicsDecomposition & result)
+        {
+            poly.convexDecomp(result, options);
+            return result.getNumberPieces();
+        });
+    }
+    else if(operation == "decomp_parallel")
+    {
+        ThreadPool pool(settings.threads);
+        return measure(settings, [&]() { return ConcavePolygon(verts); },
+                       [&](ConcavePolygon & poly)
+        {
+            convexDecompParallel(poly, pool, 2048, options);
+            return countLeaves(poly);
+        });
+    }
+    else if(operation == "slice_polygon")
+    {
+        return measure(settings, [&]() { return ConcavePolygon(verts); },
+                       [&](ConcavePolygon & poly)
+        {
+            for(auto const & cut : cuts)
+                poly.slicePolygon(cut);
+            return countLeaves(poly);
+        });
+    }
+    else if(operation == "slice_decomposed")
+    {
+        return measure(settings, [&]()
+        {
+            ConcavePolygon poly(verts);
+            poly.convexDecomp(options);
+            return poly;
+        },
+        [&](ConcavePolygon & poly)
+        {
+            for(auto const & cut : cuts)
+                poly.slicePolygon(cut);
+            return countLeaves(poly);
+        });
+    }
+
+    else if(operation == "locate_points")
+    {
+        // One query point per polygon vertex, spread over its bounding box
+        ConvexDecomposition decomposition;
+        ConcavePolygon(verts).convexDecomp(decomposition, options);
+        BasicPieceLocator<Scalar> locator(decomposition);
+
+        BasicBoundingBox<Scalar> bounds;
+        for(auto const & vert : verts)
+            bounds.expand(vert.position);
+
+        std::mt19937 random(1);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        std::vector<BasicVec2<Scalar> > points;
+        for(std::size_t i=0; i<verts.size(); ++i)
+            points.push_back({(Scalar)(bounds.lower.x + (bounds.upper.x - bounds.lower.x) * unit(random)),
+                              (Scalar)(bounds.lower.y + (bounds.upper.y - bounds.lower.y) * unit(random))});
+
+        return measure(settings, [&]() { return std::vector<int >(points.size()); },
+                       [&](std::vector<int > & pieces)
+        {
+            locator.findPieces(points, pieces);
+            return locator.getNumberPieces();
+        });
+    }
+
+    std::cerr << "unknown operation: " << operation << "\n";
+    std::exit(1);
+}
+
+std::vector<std::string > splitList(std::string const & list)
+{
+    std::vector<std::string > items;
+    std::size_t start = 0;
+    while(start <= list.size())
+    {
+        std::size_t end = list.find(',', start);
+        if(end == std::string::npos)
+            end = list.size();
+        if(end > start)
+            items.push_back(list.substr(start, end - start));
+        start = end + 1;
+    }
+    return items;
+}
+
+void printUsage()
+{
+    std::cerr <<
+        "usage: benchmark [options]\n"
+        "  --families a,b,...   star,spiral,comb,coastline,random (default: all)\n"
+        "  --ops a,b,...        decomp_tree,decomp_arena,decomp_physics,decomp_parallel,\n"
+        "                       slice_polygon,slice_decomposed,locate_points\n"
+        "                       (default: decomp_tree,decomp_arena,slice_polygon)\n"
+        "  --sizes n,m,...      vertex counts (default: 10,100,1000,10000,100000)\n"
+        "  --max-vertices n     use powers of ten from 10 up to n, e.g. 1000000\n"
+        "  --min-time s         repeat each case for at least s seconds (default 0.2)\n"
+        "  --max-reps n         cap on repetitions per case (default 50)\n"
+        "  --threads n          pool size for decomp_parallel (default: all cores)\n"
+        "  --sharpest           resolve the sharpest reflex vertex first\n"
+        "  --bounded n          CutSearch::Bounded with at most n visibility tests\n"
+        "  --merge              merge pieces after flat decompositions\n"
+        "  --float              decompose in single precision (ConcavePolygonf)\n"
+        "  --csv                write CSV instead of JSON lines\n";
+}
+
+int main(int argc, char ** argv)
+{
+    Settings settings;
+    settings.sizes = {10, 100, 1000, 10000, 100000};
+    settings.operations = {"decomp_tree", "decomp_arena", "slice_polygon"};
+    settings.minSeconds = 0.2;
+    settings.maxRepetitions = 50;
+    settings.threads = 0;
+    settings.csv = false;
+    settings.useFloat = false;
+
+    for(auto const & family : FAMILIES)
+        settings.families.push_back(family.name);
+
+    for(int i=1; i<argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i+1 < argc;
+
+        if(arg == "--families" && hasValue)
+            settings.families = splitList(argv[++i]);
+        else if(arg == "--ops" && hasValue)
+            settings.operations = splitList(argv[++i]);
+        else if(arg == "--sizes" && hasValue)
+        {
+            settings.sizes.clear();
+            for(auto const & item : splitList(argv[++i]))
+                settings.sizes.push_back(std::atoi(item.c_str()));
+        }
+        else if(arg == "--max-vertices" && hasValue)
+        {
+            int maxVertices = std::atoi(argv[++i]);
+            settings.sizes.clear();
+            for(long long n=10; n<=maxVertices; n*=10)
+                settings.sizes.push_back(n);
+        }
+        else if(arg == "--min-time" && hasValue)
+            settings.minSeconds = std::atof(argv[++i]);
+        else if(arg == "--max-reps" && hasValue)
+            settings.maxRepetitions = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--threads" && hasValue)
+            settings.threads = std::atoi(argv[++i]);
+        else if(arg == "--sharpest")
+            settings.options.reflexOrder = ReflexOrder::Sharpest;
+        else if(arg == "--bounded" && hasValue)
+        {
+            settings.options.cutSearch = CutSearch::Bounded;
+            settings.options.maxVisibilityTests = std::atoi(argv[++i]);
+        }
+        else if(arg == "--merge")
+            settings.options.mergePieces = true;
+        else if(arg == "--float")
+            settings.useFloat = true;
+        else if(arg == "--csv")
+            settings.csv = true;
+        else
+        {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    if(settings.csv)
+        std::cout << "family,vertices,scalar,operation,repetitions,ns,ns_per_vertex,pieces,peak_heap_bytes,max_rss_kb\n";
+
+    for(auto const & familyName : settings.families)
+    {
+        Family const * family = nullptr;
+        for(auto const & candidate : FAMILIES)
+            if(familyName == candidate.name)
+                family = &candidate;
+
+        if(family == nullptr)
+        {
+            std::cerr << "unknown family: " << familyName << "\n";
+            return 1;
+        }
+
+        for(int size : settings.sizes)
+        {
+            std::vector<Vertex > verts = family->generate(std::max(size, 10));
+
+            for(auto const & operation : settings.operations)
+            {
+                Measurement m = settings.useFloat ?
+                    runOperation<float>(settings, operation, verts) :
+                    runOperation<double>(settings, operation, verts);
+                double nsPerVertex = m.nanoseconds / verts.size();
+                const char * scalar = settings.useFloat ? "float" : "double";
+
+                if(settings.csv)
+                {
+                    std::cout << family->name << "," << verts.size() << "," << scalar << "," << operation << ","
+                              << m.repetitions << "," << (long long)m.nanoseconds << ","
+                              << nsPerVertex << "," << m.pieces << "," << m.peakHeap << ","
+                              << getMaxRssKb() << "\n";
+                }
+                else
+                {
+                    std::cout << "{\"family\":\"" << family->name << "\""
+                              << ",\"vertices\":" << verts.size()
+                              << ",\"scalar\":\"" << scalar << "\""
+                              << ",\"operation\":\"" << operation << "\""
+                              << ",\"repetitions\":" << m.repetitions
+                              << ",\"ns\":" << (long long)m.nanoseconds
+                              << ",\"ns_per_vertex\":" << nsPerVertex
+                              << ",\"pieces\":" << m.pieces
+                              << ",\"peak_heap_bytes\":" << m.peakHeap
+                              << ",\"max_rss_kb\":" << getMaxRssKb() << "}\n";
+                }
+                std::cout.flush();
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,563 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+#include "./src/ConcavePolygon.h"
+#include "./src/ThreadPool.h"
+
+using namespace cxd;
+
+// Headless decomposer for asset pipelines. Polygons are streamed from the
+// input files (or stdin) in batches, each batch is decomposed by a task on
+// a thread pool, and the batches are written out in input order. Only a
+// bounded number of batches is in flight at once, so memory does not grow
+// with the size of the input.
+//
+// Text format: one polygon per line as x y pairs separated by spaces or
+// commas; blank lines and lines starting with # are skipped. The output
+// has one line per polygon, with its pieces separated by ';'.
+//
+// Binary format: per polygon a little endian uint32 vertex count followed
+// by the x y pairs as little endian doubles (floats with --float). The
+// output has per polygon a uint32 piece count and, per piece, a uint32
+// vertex count followed by its x y pairs.
+//
+// Polygons with more than MAX_POLYGON_VERTICES vertices are rejected in
+// either format, so a corrupt count cannot exhaust memory.
+namespace
+{
+
+const std::size_t MAX_POLYGON_VERTICES = 1 << 24;
+
+// Vertices read from binary input per read call
+const std::size_t READ_CHUNK_VERTICES = 4096;
+
+struct Settings
+{
+    std::vector<std::string > inputs;
+    std::string outputPath;
+    unsigned int threads;
+    std::size_t batchVertices;
+    std::size_t maxBatches;
+    bool binaryInput;
+    bool binaryOutput;
+    bool useFloat;
+    bool quiet;
+    DecompOptions options;
+};
+
+// Per polygon decomposition times on a log scale, so percentiles over an
+// arbitrarily long stream fit in a fixed amount of memory. Bucket i counts
+// times below 2^((i+1)/4) nanoseconds, so percentiles are within 19%.
+class LatencyHistogram
+{
+    static const int BUCKETS = 160;
+
+    long long counts[BUCKETS];
+    long long total;
+    double maxSeconds;
+
+public:
+    LatencyHistogram() : total{0}, maxSeconds{0.0}
+    {
+        std::fill(counts, counts + BUCKETS, 0);
+    }
+
+    void add(double seconds)
+    {
+        double nanoseconds = seconds * 1e9;
+        int bucket = nanoseconds > 1.0 ? (int)(4.0 * std::log2(nanoseconds)) : 0;
+        ++counts[std::min(bucket, BUCKETS - 1)];
+        ++total;
+        maxSeconds = std::max(maxSeconds, seconds);
+    }
+
+    void merge(LatencyHistogram const & other)
+    {
+        for(int i=0; i<BUCKETS; ++i)
+            counts[i] += other.counts[i];
+        total += other.total;
+        maxSeconds = std::max(maxSeconds, other.maxSeconds);
+    }
+
+    // Upper edge of the bucket holding the given fraction of the times
+    double percentile(double fraction) const
+    {
+        long long target = (long long)(fraction * total);
+        long long seen = 0;
+
+        for(int i=0; i<BUCKETS; ++i)
+        {
+            seen += counts[i];
+            if(seen > target)
+                return std::min(std::exp2((i + 1) / 4.0) * 1e-9, maxSeconds);
+        }
+
+        return maxSeconds;
+    }
+
+    double getMaxSeconds() const
+    {
+        return maxSeconds;
+    }
+};
+
+struct StreamStats
+{
+    long long polygons;
+    long long vertices;
+    long long pieces;
+    double seconds;
+    LatencyHistogram latency;
+
+    StreamStats() : polygons{0}, vertices{0}, pieces{0}, seconds{0.0} {}
+
+    void merge(StreamStats const & other)
+    {
+        polygons += other.polygons;
+        vertices += other.vertices;
+        pieces += other.pieces;
+        latency.merge(other.latency);
+    }
+};
+
+void printStats(std::string const & name, StreamStats const & stats)
+{
+    double seconds = std::max(stats.seconds, 1e-9);
+
+    std::fprintf(stderr, "%s: %lld polygons, %lld vertices, %lld pieces in %.3f s "
+                 "(%.0f polygons/s, %.0f vertices/s); latency p50 %.1f us, p99 %.1f us, max %.1f us\n",
+                 name.c_str(), stats.polygons, stats.vertices, stats.pieces, stats.seconds,
+                 stats.polygons / seconds, stats.vertices / seconds,
+                 stats.latency.percentile(0.5) * 1e6, stats.latency.percentile(0.99) * 1e6,
+                 stats.latency.getMaxSeconds() * 1e6);
+}
+
+void fail(std::string const & name, long long record, char const * message)
+{
+    std::fprintf(stderr, "%s:%lld: %s\n", name.c_str(), record, message);
+    std::exit(1);
+}
+
+template<typename Scalar>
+struct Batch
+{
+    typedef BasicVertex<Scalar> Vertex;
+
+    // Polygon i is vertices[polygons[i].first] onwards
+    std::vector<Vertex > vertices;
+    std::vector<PieceRange > polygons;
+
+    std::string output;
+    StreamStats stats;
+    TaskGroup group;
+
+    void appendBinary(std::uint32_t value)
+    {
+        for(int i=0; i<4; ++i)
+            output.push_back((char)((value >> (8*i)) & 0xff));
+    }
+
+    void appendBinary(Scalar value)
+    {
+        typedef typename std::conditional<sizeof(Scalar) == 4, std::uint32_t, std::uint64_t>::type Bits;
+
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(Scalar));
+        for(unsigned int i=0; i<sizeof(Scalar); ++i)
+            output.push_back((char)((bits >> (8*i)) & 0xff));
+    }
+
+    void appendText(BasicConvexDecomposition<Scalar> const & decomposition)
+    {
+        char number[64];
+        int digits = sizeof(Scalar) == 4 ? 9 : 17;
+
+        for(int i=0; i<decomposition.getNumberPieces(); ++i)
+        {
+            if(i > 0)
+                output.push_back(';');
+
+            BasicVertexSpan<Scalar> piece = decomposition.getPiece(i);
+            for(unsigned int j=0; j<piece.size(); ++j)
+            {
+                if(j > 0)
+                    output.push_back(' ');
+                int length = std::snprintf(number, sizeof(number), "%.*g %.*g",
+                                           digits, (double)piece[j].position.x,
+                                           digits, (double)piece[j].position.y);
+                output.append(number, length);
+            }
+        }
+
+        output.push_back('\n');
+    }
+
+    void run(Settings const & settings)
+    {
+        BasicConvexDecomposition<Scalar> decomposition;
+
+        for(PieceRange const & range : polygons)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            BasicConcavePolygon<Scalar> polygon(BasicVertexSpan<Scalar>(vertices.data() + range.first, range.count));
+            polygon.convexDecomp(decomposition, settings.options);
+
+            auto end = std::chrono::steady_clock::now();
+            stats.latency.add(std::chrono::duration<double>(end - start).count());
+            stats.pieces += decomposition.getNumberPieces();
+
+            if(settings.binaryOutput)
+            {
+                appendBinary((std::uint32_t)decomposition.getNumberPieces());
+                for(int i=0; i<decomposition.getNumberPieces(); ++i)
+                {
+                    BasicVertexSpan<Scalar> piece = decomposition.getPiece(i);
+                    appendBinary((std::uint32_t)piece.size());
+                    for(auto const & vertex : piece)
+                    {
+                        appendBinary(vertex.position.x);
+                        appendBinary(vertex.position.y);
+                    }
+                }
+            }
+            else
+                appendText(decomposition);
+        }
+
+        stats.polygons = polygons.size();
+        stats.vertices = vertices.size();
+
+        // The input is no longer needed while the batch waits its turn
+        std::vector<Vertex >().swap(vertices);
+        std::vector<PieceRange >().swap(polygons);
+    }
+};
+
+// Reads one polygon at a time into a batch
+template<typename Scalar>
+class PolygonReader
+{
+    typedef BasicVertex<Scalar> Vertex;
+
+    std::istream & stream;
+    std::string name;
+    bool binary;
+    long long record;
+    std::string line;
+    std::vector<unsigned char> chunk;
+
+    bool readText(Batch<Scalar> & batch)
+    {
+        while(std::getline(stream, line))
+        {
+            ++record;
+
+            char const * cursor = line.c_str();
+            while(*cursor == ' ' || *cursor == '\t' || *cursor == '\r')
+                ++cursor;
+            if(*cursor == '\0' || *cursor == '#')
+                continue;
+
+            PieceRange range = {(unsigned int)batch.vertices.size(), 0};
+            Scalar coordinates[2];
+            int numCoordinates = 0;
+
+            while(true)
+            {
+                while(*cursor == ' ' || *cursor == '\t' || *cursor == '\r' || *cursor == ',')
+                    ++cursor;
+                if(*cursor == '\0')
+                    break;
+
+                char * end;
+                double value = std::strtod(cursor, &end);
+                if(end == cursor)
+                    fail(name, record, "expected a number");
+                cursor = end;
+
+                coordinates[numCoordinates++] = (Scalar)value;
+                if(numCoordinates == 2)
+                {
+                    if(batch.vertices.size() - range.first >= MAX_POLYGON_VERTICES)
+                        fail(name, record, "too many vertices");
+                    batch.vertices.push_back(Vertex({coordinates[0], coordinates[1]}));
+                    numCoordinates = 0;
+                }
+            }
+
+            if(numCoordinates != 0)
+                fail(name, record, "odd number of coordinates");
+
+            range.count = batch.vertices.size() - range.first;
+            batch.polygons.push_back(range);
+            return true;
+        }
+
+        if(stream.bad())
+            fail(name, record, "read error");
+
+        return false;
+    }
+
+    bool readBinary(Batch<Scalar> & batch)
+    {
+        typedef typename std::conditional<sizeof(Scalar) == 4, std::uint32_t, std::uint64_t>::type Bits;
+
+        unsigned char header[4];
+        if(stream.read((char *)header, 4).gcount() == 0)
+            return false;
+
+        ++record;
+        if(stream.gcount() != 4)
+            fail(name, record, "truncated vertex count");
+
+        std::size_t numVertices = header[0] | header[1] << 8 | header[2] << 16 | (std::uint32_t)header[3] << 24;
+        if(numVertices > MAX_POLYGON_VERTICES)
+            fail(name, record, "too many vertices");
+
+        PieceRange range = {(unsigned int)batch.vertices.size(), (unsigned int)numVertices};
+        std::size_t vertexBytes = 2 * sizeof(Scalar);
+        chunk.resize(READ_CHUNK_VERTICES * vertexBytes);
+
+        for(std::size_t first=0; first<numVertices; first+=READ_CHUNK_VERTICES)
+        {
+            std::size_t count = std::min(numVertices - first, READ_CHUNK_VERTICES);
+            std::streamsize chunkBytes = (std::streamsize)(count * vertexBytes);
+            if(stream.read((char *)chunk.data(), chunkBytes).gcount() != chunkBytes)
+                fail(name, record, "truncated vertices");
+
+            for(std::size_t i=0; i<count; ++i)
+            {
+                Scalar coordinates[2];
+                for(std::size_t axis=0; axis<2; ++axis)
+                {
+                    unsigned char const * source = &chunk[(2*i + axis) * sizeof(Scalar)];
+                    Bits bits = 0;
+                    for(unsigned int k=0; k<sizeof(Scalar); ++k)
+                        bits |= (Bits)source[k] << (8*k);
+                    std::memcpy(&coordinates[axis], &bits, sizeof(Scalar));
+                }
+                batch.vertices.push_back(Vertex({coordinates[0], coordinates[1]}));
+            }
+        }
+
+        batch.polygons.push_back(range);
+        return true;
+    }
+
+public:
+    PolygonReader(std::istream & _stream, std::string const & _name, bool _binary) :
+        stream(_stream), name{_name}, binary{_binary}, record{0} {}
+
+    // Appends the next polygon to the batch, false at the end of input
+    bool read(Batch<Scalar> & batch)
+    {
+        return binary ? readBinary(batch) : readText(batch);
+    }
+};
+
+template<typename Scalar>
+StreamStats processStream(std::istream & input,
+                          std::string const & name,
+                          std::ostream & output,
+                          Settings const & settings,
+                          ThreadPool & pool)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    StreamStats stats;
+    PolygonReader<Scalar> reader(input, name, settings.binaryInput);
+    std::deque<std::unique_ptr<Batch<Scalar> > > inFlight;
+
+    // Waits for the oldest batch, running queued batches meanwhile, and
+    // writes it out
+    auto finishOldest = [&]()
+    {
+        Batch<Scalar> & batch = *inFlight.front();
+        pool.wait(batch.group);
+        output.write(batch.output.data(), batch.output.size());
+        stats.merge(batch.stats);
+        inFlight.pop_front();
+    };
+
+    bool more = true;
+    while(more)
+    {
+        std::unique_ptr<Batch<Scalar> > batch(new Batch<Scalar>());
+
+        while(batch->vertices.size() < settings.batchVertices && (more = reader.read(*batch)))
+            ;
+
+        if(batch->polygons.empty())
+            break;
+
+        Batch<Scalar> * submitted = batch.get();
+        pool.submit(submitted->group, [submitted, &settings]()
+        {
+            submitted->run(settings);
+        });
+        inFlight.push_back(std::move(batch));
+
+        while(inFlight.size() >= settings.maxBatches)
+            finishOldest();
+    }
+
+    while(inFlight.empty() == false)
+        finishOldest();
+
+    output.flush();
+    if(output.fail())
+        fail(name, stats.polygons, "write error");
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+template<typename Scalar>
+int run(Settings const & settings)
+{
+    ThreadPool pool(settings.threads);
+
+    std::ofstream outputFile;
+    std::ostream * output = &std::cout;
+    if(settings.outputPath.empty() == false)
+    {
+        outputFile.open(settings.outputPath, std::ios::binary);
+        if(!outputFile)
+        {
+            std::fprintf(stderr, "cannot open %s\n", settings.outputPath.c_str());
+            return 1;
+        }
+        output = &outputFile;
+    }
+
+    StreamStats total;
+    auto start = std::chrono::steady_clock::now();
+
+    for(auto const & path : settings.inputs)
+    {
+        StreamStats stats;
+
+        if(path == "-")
+            stats = processStream<Scalar>(std::cin, "stdin", *output, settings, pool);
+        else
+        {
+            std::ifstream input(path, std::ios::binary);
+            if(!input)
+            {
+                std::fprintf(stderr, "cannot open %s\n", path.c_str());
+                return 1;
+            }
+            stats = processStream<Scalar>(input, path, *output, settings, pool);
+        }
+
+        if(settings.quiet == false)
+            printStats(path == "-" ? "stdin" : path, stats);
+        total.merge(stats);
+    }
+
+    total.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if(settings.quiet == false && settings.inputs.size() > 1)
+        printStats("total", total);
+
+    return 0;
+}
+
+void printUsage()
+{
+    std::cerr <<
+        "usage: decompose [options] [file ...]\n"
+        "Decomposes every polygon of the input files, or of stdin when none\n"
+        "or '-' is given, and writes the pieces to stdout in input order.\n"
+        "  -o path              write the pieces to path instead of stdout\n"
+        "  --binary-in          read length prefixed little endian polygons\n"
+        "  --binary-out         write length prefixed little endian pieces\n"
+        "  --float              decompose in single precision (ConcavePolygonf)\n"
+        "  --threads n          pool size (default: all cores)\n"
+        "  --batch n            vertices per batch (default 65536)\n"
+        "  --max-batches n      batches in flight (default: 2 per thread + 2)\n"
+        "  --sharpest           resolve the sharpest reflex vertex first\n"
+        "  --bounded n          CutSearch::Bounded with at most n visibility tests\n"
+        "  --merge              merge pieces whose union is convex\n"
+        "  --quiet              do not print statistics to stderr\n";
+}
+
+}
+
+int main(int argc, char ** argv)
+{
+    std::ios::sync_with_stdio(false);
+
+    Settings settings;
+    settings.threads = 0;
+    settings.batchVertices = 65536;
+    settings.maxBatches = 0;
+    settings.binaryInput = false;
+    settings.binaryOutput = false;
+    settings.useFloat = false;
+    settings.quiet = false;
+
+    for(int i=1; i<argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i+1 < argc;
+
+        if(arg == "-o" && hasValue)
+            settings.outputPath = argv[++i];
+        else if(arg == "--binary-in")
+            settings.binaryInput = true;
+        else if(arg == "--binary-out")
+            settings.binaryOutput = true;
+        else if(arg == "--float")
+            settings.useFloat = true;
+        else if(arg == "--threads" && hasValue)
+            settings.threads = std::atoi(argv[++i]);
+        else if(arg == "--batch" && hasValue)
+            settings.batchVertices = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--max-batches" && hasValue)
+            settings.maxBatches = std::max(1, std::atoi(argv[++i]));
+        else if(arg == "--sharpest")
+            settings.options.reflexOrder = ReflexOrder::Sharpest;
+        else if(arg == "--bounded" && hasValue)
+        {
+            settings.options.cutSearch = CutSearch::Bounded;
+            settings.options.maxVisibilityTests = std::atoi(argv[++i]);
+        }
+        else if(arg == "--merge")
+            settings.options.mergePieces = true;
+        else if(arg == "--quiet")
+            settings.quiet = true;
+        else if(arg == "-" || arg.compare(0, 1, "-") != 0)
+            settings.inputs.push_back(arg);
+        else
+        {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+    if(settings.inputs.empty())
+        settings.inputs.push_back("-");
+
+    if(settings.maxBatches == 0)
+    {
+        unsigned int threads = settings.threads > 0 ? settings.threads : std::thread::hardware_concurrency();
+        settings.maxBatches = 2 * std::max(threads, 1u) + 2;
+    }
+
+    return settings.useFloat ? run<float>(settings) : run<double>(settings);
+}
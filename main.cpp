@@ -7,17 +7,6 @@ using namespace cxd;
 
 void drawPolygon(sf::RenderWindow& window, ConcavePolygon const & poly)
 {
-    if(poly.getNumberSubPolys() > 0)
-    {
-        drawPolygon(window, poly.getSubPolygon(0));
-        drawPolygon(window, poly.getSubPolygon(1));
-    }
-    else
-    {
-    std::vector<Vertex > const & verts = poly.getVertices();
-
-    std::vector<sf::Vertex > realVerts;
-
     sf::Text text;
     sf::Font font;
     font.loadFromFile("./fonts/courbd.ttf");
@@ -25,28 +14,32 @@ void drawPolygon(sf::RenderWindow& window, ConcavePolygon const & poly)
     //text.setCharacterSize(5);
     text.setScale({0.01f, 0.01f});
 
-    for(unsigned int i=0; i<verts.size(); ++i)
+    poly.forEachLeaf([&](VertexSpan verts)
     {
-        sf::Vector2f position = {verts[i].position.x, verts[i].position.y};
-        realVerts.push_back(sf::Vertex(position));
+        std::vector<sf::Vertex > realVerts;
 
-        text.setString(std::to_string(i));
-        text.setPosition(position + sf::Vector2f{0.005f, 0.0f});
-        window.draw(text);
-    }
-    if(realVerts.size() > 0)
-        realVerts.push_back(realVerts[0]);
+        for(unsigned int i=0; i<verts.size(); ++i)
+        {
+            sf::Vector2f position = {(float)verts[i].position.x, (float)verts[i].position.y};
+            realVerts.push_back(sf::Vertex(position));
 
-    window.draw(realVerts.data(), realVerts.size(), sf::LineStrip);
-    }
+            text.setString(std::to_string(i));
+            text.setPosition(position + sf::Vector2f{0.005f, 0.0f});
+            window.draw(text);
+        }
+        if(realVerts.size() > 0)
+            realVerts.push_back(realVerts[0]);
+
+        window.draw(realVerts.data(), realVerts.size(), sf::LineStrip);
+    });
 }
 
 void drawLineSegment(sf::RenderWindow& window, LineSegment const & seg)
 {
-    sf::Vector2f position = {seg.startPos.x, seg.startPos.y};
+    sf::Vector2f position = {(float)seg.startPos.x, (float)seg.startPos.y};
     sf::Color color = {100,150,100,100};
     sf::Vertex v1{position, color};
-    position = {seg.finalPos.x, seg.finalPos.y};
+    position = {(float)seg.finalPos.x, (float)seg.finalPos.y};
     sf::Vertex v2{position, color};
 
     std::vector<sf::Vertex > verts = {v1, v2};
@@ -103,7 +96,7 @@ void drawVertices(sf::RenderWindow & window, std::vector<Vertex > const & vertic
     std::vector<sf::Vertex > realVerts;
     for(unsigned int i=0; i<vertices.size(); ++i)
     {
-        sf::Vector2f position = {vertices[i].position.x, vertices[i].position.y};
+        sf::Vector2f position = {(float)vertices[i].position.x, (float)vertices[i].position.y};
         realVerts.push_back(sf::Vertex(position, color));
     }
     if(realVerts.size() > 0)
@@ -0,0 +1,402 @@
+#ifndef CXD_BAKED_DECOMPOSITION_H
+#define CXD_BAKED_DECOMPOSITION_H
+
+#include "ConcavePolygon.h"
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define CXD_HAS_MMAP
+#endif
+
+namespace cxd
+{
+
+// Baked decomposition files, version 1. Every value is little endian.
+//
+//   offset  size  field
+//   0       4     magic "CXDB"
+//   4       4     version, 1
+//   8       4     size of a scalar in bytes, 4 (float) or 8 (double)
+//   12      4     flags, BAKED_HAS_PROPERTIES
+//   16      4     number of input polygon vertices
+//   20      4     number of pieces
+//   24      4     number of piece vertices
+//   28      4     reserved, 0
+//   32      8     offset of the input polygon vertices
+//   40      8     offset of the piece ranges
+//   48      8     offset of the piece vertices
+//   56      8     offset of the piece properties, 0 when absent
+//
+// Vertices are x, y scalar pairs and piece ranges are PieceRange's first
+// and count. Properties are BasicBakedPieceProperties records. Sections
+// start at multiples of 64 bytes and offsets are from the start of the
+// file, so a file mapped at a page boundary can be read in place.
+static const std::uint32_t BAKED_VERSION = 1;
+static const std::uint32_t BAKED_HAS_PROPERTIES = 1;
+static const std::uint32_t BAKED_HEADER_SIZE = 64;
+static const std::uint32_t BAKED_SECTION_ALIGNMENT = 64;
+
+enum class BakedStatus
+{
+    Ok,
+    Truncated,          // shorter than its header or sections say
+    BadMagic,           // not a baked decomposition
+    UnsupportedVersion, // written by a newer version of this header
+    ScalarMismatch,     // baked in the other precision
+    Misaligned,         // sections not aligned for in place reading
+    Corrupt,            // a piece range lies outside the vertices
+    BigEndianHost       // the host cannot read little endian in place
+};
+
+// Bounding box, centroid and area of one piece, as BasicPieceProperties
+// holds them
+template<typename Scalar>
+struct BasicBakedPieceProperties
+{
+    BasicBoundingBox<Scalar> bounds;
+    BasicVec2<Scalar> centroid;
+    Scalar area;
+    Scalar reserved;
+};
+
+namespace detail
+{
+
+inline bool isLittleEndianHost()
+{
+    std::uint32_t one = 1;
+    unsigned char first;
+    std::memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+inline void writeLittleEndian(std::ostream & stream, std::uint64_t value, int numBytes)
+{
+    char bytes[8];
+    for(int i=0; i<numBytes; ++i)
+        bytes[i] = (char)((value >> (8*i)) & 0xff);
+    stream.write(bytes, numBytes);
+}
+
+template<typename Scalar>
+inline void writeScalar(std::ostream & stream, Scalar value)
+{
+    typedef typename std::conditional<sizeof(Scalar) == 4, std::uint32_t, std::uint64_t>::type Bits;
+
+    Bits bits;
+    std::memcpy(&bits, &value, sizeof(Scalar));
+    writeLittleEndian(stream, bits, sizeof(Scalar));
+}
+
+inline std::uint64_t readLittleEndian(unsigned char const * bytes, int numBytes)
+{
+    std::uint64_t value = 0;
+    for(int i=0; i<numBytes; ++i)
+        value |= (std::uint64_t)bytes[i] << (8*i);
+    return value;
+}
+
+inline std::uint64_t alignSection(std::uint64_t offset)
+{
+    return (offset + BAKED_SECTION_ALIGNMENT - 1) / BAKED_SECTION_ALIGNMENT * BAKED_SECTION_ALIGNMENT;
+}
+
+inline void padTo(std::ostream & stream, std::uint64_t & position, std::uint64_t offset)
+{
+    for(; position < offset; ++position)
+        stream.put(0);
+}
+
+}
+
+// Writes the input polygon and its pieces in the baked format. With
+// includeProperties the bounds, centroid and area of every piece are
+// stored too. The output is the same on every host. Returns false, having
+// written nothing, if a count does not fit its 32 bit header field, and
+// false if the stream failed.
+template<typename Scalar>
+bool writeBakedDecomposition(std::ostream & stream,
+                             BasicVertexSpan<Scalar> input,
+                             BasicConvexDecomposition<Scalar> const & decomposition,
+                             bool includeProperties = true)
+{
+    std::uint64_t vertexSize = 2 * sizeof(Scalar);
+    std::uint64_t numPieces = decomposition.pieces.size();
+
+    if(input.size() > UINT32_MAX || numPieces > UINT32_MAX ||
+       decomposition.vertices.size() > UINT32_MAX)
+        return false;
+
+    std::uint64_t inputOffset = BAKED_HEADER_SIZE;
+    std::uint64_t rangesOffset = detail::alignSection(inputOffset + input.size() * vertexSize);
+    std::uint64_t verticesOffset = detail::alignSection(rangesOffset + numPieces * sizeof(PieceRange));
+    std::uint64_t propertiesOffset = includeProperties ?
+        detail::alignSection(verticesOffset + decomposition.vertices.size() * vertexSize) : 0;
+
+    stream.write("CXDB", 4);
+    detail::writeLittleEndian(stream, BAKED_VERSION, 4);
+    detail::writeLittleEndian(stream, sizeof(Scalar), 4);
+    detail::writeLittleEndian(stream, includeProperties ? BAKED_HAS_PROPERTIES : 0, 4);
+    detail::writeLittleEndian(stream, input.size(), 4);
+    detail::writeLittleEndian(stream, numPieces, 4);
+    detail::writeLittleEndian(stream, decomposition.vertices.size(), 4);
+    detail::writeLittleEndian(stream, 0, 4);
+    detail::writeLittleEndian(stream, inputOffset, 8);
+    detail::writeLittleEndian(stream, rangesOffset, 8);
+    detail::writeLittleEndian(stream, verticesOffset, 8);
+    detail::writeLittleEndian(stream, propertiesOffset, 8);
+
+    std::uint64_t position = BAKED_HEADER_SIZE;
+
+    for(auto const & vertex : input)
+    {
+        detail::writeScalar(stream, vertex.position.x);
+        detail::writeScalar(stream, vertex.position.y);
+    }
+    position += input.size() * vertexSize;
+
+    detail::padTo(stream, position, rangesOffset);
+    for(auto const & range : decomposition.pieces)
+    {
+        detail::writeLittleEndian(stream, range.first, 4);
+        detail::writeLittleEndian(stream, range.count, 4);
+    }
+    position += numPieces * sizeof(PieceRange);
+
+    detail::padTo(stream, position, verticesOffset);
+    for(auto const & vertex : decomposition.vertices)
+    {
+        detail::writeScalar(stream, vertex.position.x);
+        detail::writeScalar(stream, vertex.position.y);
+    }
+    position += decomposition.vertices.size() * vertexSize;
+
+    if(includeProperties)
+    {
+        detail::padTo(stream, position, propertiesOffset);
+
+        BasicPhysicsDecomposition<Scalar> physics;
+
+        for(unsigned int i=0; i<numPieces; ++i)
+        {
+            physics.clear();
+            physics.addPiece(decomposition.getPiece(i));
+            BasicPieceProperties<Scalar> const & properties = physics.getPiece(0);
+
+            detail::writeScalar(stream, properties.bounds.lower.x);
+            detail::writeScalar(stream, properties.bounds.lower.y);
+            detail::writeScalar(stream, properties.bounds.upper.x);
+            detail::writeScalar(stream, properties.bounds.upper.y);
+            detail::writeScalar(stream, properties.centroid.x);
+            detail::writeScalar(stream, properties.centroid.y);
+            detail::writeScalar(stream, properties.area);
+            detail::writeScalar(stream, Scalar(0));
+        }
+    }
+
+    return stream.good();
+}
+
+// Read only view of a baked decomposition held in memory, e.g. a mapped
+// file. Nothing is copied or allocated: every span points into the bytes
+// given to open, which must outlive the view.
+template<typename Scalar>
+class BasicBakedDecomposition
+{
+    typedef BasicVertex<Scalar> Vertex;
+    typedef BasicVertexSpan<Scalar> VertexSpan;
+    typedef BasicBakedPieceProperties<Scalar> BakedPieceProperties;
+
+    static_assert(sizeof(Vertex) == 2 * sizeof(Scalar), "vertices must be two packed scalars");
+    static_assert(sizeof(PieceRange) == 8, "piece ranges must be two packed 32 bit integers");
+    static_assert(sizeof(BakedPieceProperties) == 8 * sizeof(Scalar), "properties must be eight packed scalars");
+
+    VertexSpan input;
+    VertexSpan vertices;
+    Span<PieceRange const> pieces;
+    Span<BakedPieceProperties const> properties;
+    bool propertiesStored;
+
+    static bool fits(std::uint64_t offset, std::uint64_t length, std::size_t size)
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+public:
+    BasicBakedDecomposition() : propertiesStored{false} {}
+
+    BakedStatus open(void const * data, std::size_t size)
+    {
+        *this = BasicBakedDecomposition();
+
+        unsigned char const * bytes = static_cast<unsigned char const *>(data);
+
+        if(detail::isLittleEndianHost() == false)
+            return BakedStatus::BigEndianHost;
+        if(size < BAKED_HEADER_SIZE)
+            return BakedStatus::Truncated;
+        if(std::memcmp(bytes, "CXDB", 4) != 0)
+            return BakedStatus::BadMagic;
+        if(detail::readLittleEndian(bytes + 4, 4) != BAKED_VERSION)
+            return BakedStatus::UnsupportedVersion;
+        if(detail::readLittleEndian(bytes + 8, 4) != sizeof(Scalar))
+            return BakedStatus::ScalarMismatch;
+
+        std::uint64_t flags = detail::readLittleEndian(bytes + 12, 4);
+        std::uint64_t numInput = detail::readLittleEndian(bytes + 16, 4);
+        std::uint64_t numPieces = detail::readLittleEndian(bytes + 20, 4);
+        std::uint64_t numVertices = detail::readLittleEndian(bytes + 24, 4);
+        std::uint64_t inputOffset = detail::readLittleEndian(bytes + 32, 8);
+        std::uint64_t rangesOffset = detail::readLittleEndian(bytes + 40, 8);
+        std::uint64_t verticesOffset = detail::readLittleEndian(bytes + 48, 8);
+        std::uint64_t propertiesOffset = detail::readLittleEndian(bytes + 56, 8);
+        bool hasProperties = (flags & BAKED_HAS_PROPERTIES) != 0;
+
+        if(fits(inputOffset, numInput * sizeof(Vertex), size) == false ||
+           fits(rangesOffset, numPieces * sizeof(PieceRange), size) == false ||
+           fits(verticesOffset, numVertices * sizeof(Vertex), size) == false ||
+           (hasProperties && fits(propertiesOffset, numPieces * sizeof(BakedPieceProperties), size) == false))
+            return BakedStatus::Truncated;
+
+        if((reinterpret_cast<std::uintptr_t>(bytes) | inputOffset | rangesOffset |
+            verticesOffset | propertiesOffset) % alignof(BakedPieceProperties) != 0)
+            return BakedStatus::Misaligned;
+
+        Span<PieceRange const> ranges(reinterpret_cast<PieceRange const *>(bytes + rangesOffset), numPieces);
+        for(PieceRange const & range : ranges)
+        {
+            if(range.first > numVertices || range.count > numVertices - range.first)
+                return BakedStatus::Corrupt;
+        }
+
+        input = VertexSpan(reinterpret_cast<Vertex const *>(bytes + inputOffset), numInput);
+        vertices = VertexSpan(reinterpret_cast<Vertex const *>(bytes + verticesOffset), numVertices);
+        pieces = ranges;
+        propertiesStored = hasProperties;
+        if(hasProperties)
+            properties = Span<BakedPieceProperties const>(
+                reinterpret_cast<BakedPieceProperties const *>(bytes + propertiesOffset), numPieces);
+
+        return BakedStatus::Ok;
+    }
+
+    VertexSpan getInputVertices() const
+    {
+        return input;
+    }
+
+    // Vertices of every piece, in piece order
+    VertexSpan getVertices() const
+    {
+        return vertices;
+    }
+
+    Span<PieceRange const> getPieceRanges() const
+    {
+        return pieces;
+    }
+
+    int getNumberPieces() const
+    {
+        return pieces.size();
+    }
+
+    VertexSpan getPiece(int pieceIndex) const
+    {
+        PieceRange range = pieces[pieceIndex];
+        return VertexSpan(vertices.data() + range.first, range.count);
+    }
+
+    bool hasProperties() const
+    {
+        return propertiesStored;
+    }
+
+    BakedPieceProperties const & getProperties(int pieceIndex) const
+    {
+        return properties[pieceIndex];
+    }
+};
+
+typedef BasicBakedPieceProperties<double> BakedPieceProperties;
+typedef BasicBakedPieceProperties<float> BakedPiecePropertiesf;
+typedef BasicBakedDecomposition<double> BakedDecomposition;
+typedef BasicBakedDecomposition<float> BakedDecompositionf;
+
+#ifdef CXD_HAS_MMAP
+// A whole file mapped read only, e.g. to hand to
+// BasicBakedDecomposition::open. The mapping is page aligned.
+class MappedFile
+{
+    void * mapping;
+    std::size_t length;
+
+public:
+    MappedFile() : mapping{nullptr}, length{0} {}
+
+    MappedFile(MappedFile const &) = delete;
+    MappedFile & operator = (MappedFile const &) = delete;
+
+    ~MappedFile()
+    {
+        close();
+    }
+
+    bool open(char const * path)
+    {
+        close();
+
+        int descriptor = ::open(path, O_RDONLY);
+        if(descriptor < 0)
+            return false;
+
+        struct stat status;
+        if(fstat(descriptor, &status) != 0 || status.st_size <= 0)
+        {
+            ::close(descriptor);
+            return false;
+        }
+
+        void * address = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        ::close(descriptor);
+
+        if(address == MAP_FAILED)
+            return false;
+
+        mapping = address;
+        length = status.st_size;
+        return true;
+    }
+
+    void close()
+    {
+        if(mapping != nullptr)
+            munmap(mapping, length);
+
+        mapping = nullptr;
+        length = 0;
+    }
+
+    void const * data() const
+    {
+        return mapping;
+    }
+
+    std::size_t size() const
+    {
+        return length;
+    }
+};
+#endif
+
+}
+
+#endif // CXD_BAKED_DECOMPOSITION_H
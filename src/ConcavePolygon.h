@@ -3,106 +3,476 @@
 
 #include <vector>
 #include <cmath>
-#include <map>
-#include <iostream>
+#include <cstddef>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <iterator>
+#include <memory>
+
+#if defined(__has_include)
+#if __has_include(<memory_resource>) && __cplusplus >= 201703L
+#include <memory_resource>
+#define CXD_HAS_PMR
+#endif
+#endif
+
+#ifdef CXD_ENABLE_STATS
+#include <chrono>
+#endif
+
+// Instruction set of the edge intersection kernel. Define CXD_DISABLE_SIMD
+// to force the scalar loop, which gives identical results.
+#if !defined(CXD_DISABLE_SIMD) && defined(__AVX__)
+#include <immintrin.h>
+#define CXD_SIMD_AVX
+#elif !defined(CXD_DISABLE_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#define CXD_SIMD_SSE2
+#endif
+
+// Keeps the rarely taken exact predicates, and their large stack frames,
+// out of the loops that call the floating point filters
+#if defined(_MSC_VER)
+#define CXD_NOINLINE __declspec(noinline)
+#else
+#define CXD_NOINLINE __attribute__((noinline))
+#endif
 
 namespace cxd
 {
 
-struct Vec2
+// Tolerances of the geometry routines for each scalar type. Specialise it
+// to use another scalar type or to tune the tolerances.
+template<typename Scalar>
+struct ScalarTraits;
+
+template<>
+struct ScalarTraits<double>
+{
+    // How far past either end of a segment an intersection still counts,
+    // as a fraction of the segment's length
+    static constexpr double INTERSECTION_TOLERANCE = 1e-2;
+
+    // Vectors shorter than this have no direction. Parallel segments are
+    // detected exactly and need no tolerance.
+    static constexpr double PARALLEL_EPSILON = 1e-30;
+
+    // Vertices closer than this to a slice, scaled by the slice length,
+    // count as lying on it
+    static constexpr double SLICE_TOLERANCE = 1e-5;
+};
+
+template<>
+struct ScalarTraits<float>
+{
+    static constexpr float INTERSECTION_TOLERANCE = 1e-2f;
+    static constexpr float PARALLEL_EPSILON = 1e-30f;
+    static constexpr float SLICE_TOLERANCE = 1e-5f;
+};
+
+template<typename Scalar>
+struct BasicVec2
 {
-    double x;
-    double y;
+    Scalar x;
+    Scalar y;
 
-    static float length(Vec2 const & v)
+    static Scalar length(BasicVec2 const & v)
     {
-        return sqrtf(v.x*v.x + v.y*v.y);
+        return std::sqrt(v.x*v.x + v.y*v.y);
     }
 
-    static Vec2 norm(Vec2 const & v)
+    static BasicVec2 norm(BasicVec2 const & v)
     {
-        if(length(v) < 1e-30)
+        Scalar vLength = length(v);
+        if(vLength < ScalarTraits<Scalar>::PARALLEL_EPSILON)
             return {0.0f, 0.0f};
+
+        return v / vLength;
     }
 
-    static float dot(Vec2 const & v1, Vec2 const & v2)
+    static Scalar dot(BasicVec2 const & v1, BasicVec2 const & v2)
     {
         return v1.x * v2.x + v1.y * v2.y;
     }
 
-    static float square(Vec2 const & v)
+    static Scalar square(BasicVec2 const & v)
     {
         return dot(v,v);
     }
 
-    static float cross(Vec2 const & v1, Vec2 const & v2)
+    static Scalar cross(BasicVec2 const & v1, BasicVec2 const & v2)
     {
         return v1.x*v2.y - v1.y*v2.x;
     }
 
-    Vec2 operator - (Vec2 const & v1) const
+    BasicVec2 operator - (BasicVec2 const & v1) const
     {
         return {x - v1.x, y - v1.y};
     }
 
-    Vec2 operator + (Vec2 const & v1) const
+    BasicVec2 operator + (BasicVec2 const & v1) const
     {
         return {x + v1.x, y + v1.y};
     }
 
-    Vec2 operator * (float const & f) const
+    BasicVec2 operator * (Scalar const & f) const
     {
         return {f*x, f*y};
     }
 
-    Vec2 operator / (float const & f) const
+    BasicVec2 operator / (Scalar const & f) const
     {
         return {x/f, y/f};
     }
 
-    static float getSignedArea(Vec2 const & v1,
-                               Vec2 const & v2)
+    static Scalar getSignedArea(BasicVec2 const & v1,
+                                BasicVec2 const & v2)
     {
         return (v2.x - v1.x) * (v2.y + v1.y);
     }
 };
 
-struct Vertex
+namespace detail
+{
+
+// a*b - c*d, a*b + c*d and a*b + c as LineSegment::intersects evaluates
+// them. When FMA is available they are fused explicitly, so the compiler
+// cannot fuse them differently from the vectorised kernel.
+template<typename Scalar>
+inline Scalar mulSub(Scalar a, Scalar b, Scalar c, Scalar d)
+{
+#ifdef __FMA__
+    return std::fma(a, b, -(c*d));
+#else
+    return a*b - c*d;
+#endif
+}
+
+template<typename Scalar>
+inline Scalar mulAdd(Scalar a, Scalar b, Scalar c, Scalar d)
+{
+#ifdef __FMA__
+    return std::fma(a, b, c*d);
+#else
+    return a*b + c*d;
+#endif
+}
+
+template<typename Scalar>
+inline Scalar mulAdd(Scalar a, Scalar b, Scalar c)
+{
+#ifdef __FMA__
+    return std::fma(a, b, c);
+#else
+    return a*b + c;
+#endif
+}
+
+// Relative error bounds of the floating point filters in the geometric
+// predicates. PRODUCT covers a*b - c*d of rounded coordinate differences,
+// DOT the dot product with a rounded intersection point. Both carry enough
+// slack to also absorb the rounding of the bound computation itself.
+template<typename Scalar>
+struct ErrorBounds
+{
+    static constexpr Scalar UNIT = std::numeric_limits<Scalar>::epsilon() / 2;
+    static constexpr Scalar PRODUCT = 8 * UNIT;
+    static constexpr Scalar DOT = 16 * UNIT;
+};
+
+// Exact arithmetic for the cases the filters cannot decide, after
+// Shewchuk's "Adaptive Precision Floating-Point Arithmetic and Fast Robust
+// Geometric Predicates". An expansion is an array of doubles of increasing
+// magnitude that do not overlap; the value is their exact sum and its sign
+// is the sign of the last term. Float coordinates are converted exactly.
+
+inline void twoProduct(double a, double b, double & product, double & error)
+{
+    product = a * b;
+#if defined(__FMA__) || defined(FP_FAST_FMA)
+    error = std::fma(a, b, -product);
+#else
+    const double SPLITTER = 134217729.0;
+
+    double aBig = SPLITTER * a;
+    double aHigh = aBig - (aBig - a);
+    double aLow = a - aHigh;
+    double bBig = SPLITTER * b;
+    double bHigh = bBig - (bBig - b);
+    double bLow = b - bHigh;
+
+    error = aLow * bLow - (((product - aHigh * bHigh) - aLow * bHigh) - aHigh * bLow);
+#endif
+}
+
+// Writes a - b as an expansion of one or two terms and returns its length
+inline int exactDifference(double a, double b, double * h)
+{
+    double difference = a - b;
+    double bVirtual = a - difference;
+    double aVirtual = difference + bVirtual;
+    double error = (a - aVirtual) + (bVirtual - b);
+
+    int length = 0;
+    if(error != 0.0)
+        h[length++] = error;
+    h[length++] = difference;
+    return length;
+}
+
+// Adds b to the expansion h in place and returns its new length, which is
+// at most one more than before
+inline int growExpansion(int length, double * h, double b)
+{
+    double sum = b;
+    int newLength = 0;
+
+    for(int i=0; i<length; ++i)
+    {
+        double term = h[i];
+        double total = sum + term;
+        double termVirtual = total - sum;
+        double sumVirtual = total - termVirtual;
+        double error = (sum - sumVirtual) + (term - termVirtual);
+
+        sum = total;
+        if(error != 0.0)
+            h[newLength++] = error;
+    }
+
+    if(sum != 0.0 || newLength == 0)
+        h[newLength++] = sum;
+
+    return newLength;
+}
+
+// Adds e*f to the expansion h in place. h needs room for
+// 2*eLength*fLength more terms.
+inline int addProduct(int length, double * h,
+                      int eLength, double const * e,
+                      int fLength, double const * f)
+{
+    for(int i=0; i<eLength; ++i)
+        for(int j=0; j<fLength; ++j)
+        {
+            double product;
+            double error;
+            twoProduct(e[i], f[j], product, error);
+            length = growExpansion(length, h, error);
+            length = growExpansion(length, h, product);
+        }
+
+    return length;
+}
+
+inline int copyExpansion(int length, double const * e, double * h)
+{
+    std::copy(e, e + length, h);
+    return length;
+}
+
+inline int expansionSign(int length, double const * e)
+{
+    double last = e[length-1];
+    return last > 0.0 ? 1 : (last < 0.0 ? -1 : 0);
+}
+
+inline double estimateExpansion(int length, double const * e)
+{
+    double sum = 0.0;
+    for(int i=0; i<length; ++i)
+        sum += e[i];
+    return sum;
+}
+
+// Exact sign of cross(a1 - a0, b1 - b0)
+CXD_NOINLINE inline int exactCrossSign(double a0x, double a0y, double a1x, double a1y,
+                                       double b0x, double b0y, double b1x, double b1y)
+{
+    // Both products vanish for axis aligned directions, which are common
+    // enough to skip the expansions for
+    if((a1x == a0x || b1y == b0y) && (a1y == a0y || b1x == b0x))
+        return 0;
+
+    double ax[2], ayNegated[2], bx[2], by[2];
+    int axLength = exactDifference(a1x, a0x, ax);
+    int ayLength = exactDifference(a0y, a1y, ayNegated);
+    int bxLength = exactDifference(b1x, b0x, bx);
+    int byLength = exactDifference(b1y, b0y, by);
+
+    double cross[16];
+    int length = addProduct(0, cross, axLength, ax, byLength, by);
+    length = addProduct(length, cross, ayLength, ayNegated, bxLength, bx);
+
+    return expansionSign(length, cross);
+}
+
+// The floating point stage of crossSign: 1 or -1 when the error bound
+// proves the sign, 0 when it has to be decided exactly. Branch free, as the
+// sign is often unpredictable in the loops that call it.
+template<typename Scalar>
+inline int filteredCrossSign(BasicVec2<Scalar> const & a0, BasicVec2<Scalar> const & a1,
+                             BasicVec2<Scalar> const & b0, BasicVec2<Scalar> const & b1)
+{
+    Scalar left = (a1.x - a0.x) * (b1.y - b0.y);
+    Scalar right = (a1.y - a0.y) * (b1.x - b0.x);
+    Scalar cross = left - right;
+    Scalar bound = ErrorBounds<Scalar>::PRODUCT * (std::abs(left) + std::abs(right));
+
+    return (cross > bound) - (-cross > bound);
+}
+
+// Sign of cross(a1 - a0, b1 - b0): 1, -1 or 0 when the directions are
+// parallel. Exact for every input that does not overflow or underflow.
+template<typename Scalar>
+inline int crossSign(BasicVec2<Scalar> const & a0, BasicVec2<Scalar> const & a1,
+                     BasicVec2<Scalar> const & b0, BasicVec2<Scalar> const & b1)
+{
+    int sign = filteredCrossSign(a0, a1, b0, b1);
+    if(sign != 0)
+        return sign;
+
+    return exactCrossSign(a0.x, a0.y, a1.x, a1.y, b0.x, b0.y, b1.x, b1.y);
+}
+
+// Decides LineSegment::intersects exactly for the segments p1->q1 and
+// p2->q2, with its parameter limits given as lower, upper and end. On a hit
+// t1 is set to the parameter of the hit along the first segment.
+CXD_NOINLINE inline bool exactIntersection(double p1x, double p1y, double q1x, double q1y,
+                                           double p2x, double p2y, double q2x, double q2y,
+                                           double lower, double upper, double end,
+                                           double & t1)
+{
+    double d1x[2], d1y[2], d1yNegated[2], d2x[2], d2y[2];
+    double rx[2], ryNegated[2], rxNegated[2];
+    int d1xLength = exactDifference(q1x, p1x, d1x);
+    int d1yLength = exactDifference(q1y, p1y, d1y);
+    int d1yNegatedLength = exactDifference(p1y, q1y, d1yNegated);
+    int d2xLength = exactDifference(q2x, p2x, d2x);
+    int d2yLength = exactDifference(q2y, p2y, d2y);
+    int rxLength = exactDifference(p2x, p1x, rx);
+    int ryNegatedLength = exactDifference(p1y, p2y, ryNegated);
+    int rxNegatedLength = exactDifference(p1x, p2x, rxNegated);
+
+    // cross(d1, d2), zero for parallel segments
+    double cross[16];
+    int crossLength = addProduct(0, cross, d1xLength, d1x, d2yLength, d2y);
+    crossLength = addProduct(crossLength, cross, d1yNegatedLength, d1yNegated, d2xLength, d2x);
+
+    int signCross = expansionSign(crossLength, cross);
+    if(signCross == 0)
+        return false;
+
+    // t1 = numerator / cross
+    double numerator[16];
+    int numeratorLength = addProduct(0, numerator, rxLength, rx, d2yLength, d2y);
+    numeratorLength = addProduct(numeratorLength, numerator, ryNegatedLength, ryNegated, d2xLength, d2x);
+
+    double scaled[2048];
+    double negatedLower = -lower;
+    double negatedUpper = -upper;
+
+    int length = copyExpansion(numeratorLength, numerator, scaled);
+    length = addProduct(length, scaled, crossLength, cross, 1, &negatedLower);
+    if(expansionSign(length, scaled) * signCross < 0)
+        return false;
+
+    length = copyExpansion(numeratorLength, numerator, scaled);
+    length = addProduct(length, scaled, crossLength, cross, 1, &negatedUpper);
+    if(expansionSign(length, scaled) * signCross > 0)
+        return false;
+
+    // t2 = dot(p1 - p2, d2) + t1 * dot(d1, d2), so t2 * cross is exact
+    double relativeDot[16];
+    int relativeDotLength = addProduct(0, relativeDot, rxNegatedLength, rxNegated, d2xLength, d2x);
+    relativeDotLength = addProduct(relativeDotLength, relativeDot, ryNegatedLength, ryNegated, d2yLength, d2y);
+
+    double directionDot[16];
+    int directionDotLength = addProduct(0, directionDot, d1xLength, d1x, d2xLength, d2x);
+    directionDotLength = addProduct(directionDotLength, directionDot, d1yLength, d1y, d2yLength, d2y);
+
+    double t2Cross[1024];
+    int t2CrossLength = addProduct(0, t2Cross, relativeDotLength, relativeDot, crossLength, cross);
+    t2CrossLength = addProduct(t2CrossLength, t2Cross, numeratorLength, numerator, directionDotLength, directionDot);
+
+    length = copyExpansion(t2CrossLength, t2Cross, scaled);
+    length = addProduct(length, scaled, crossLength, cross, 1, &negatedLower);
+    if(expansionSign(length, scaled) * signCross < 0)
+        return false;
+
+    // t2 / |d2|^2 >= end, with |d2|^2 > 0 as the segments are not parallel
+    double lengthSquared[16];
+    int lengthSquaredLength = addProduct(0, lengthSquared, d2xLength, d2x, d2xLength, d2x);
+    lengthSquaredLength = addProduct(lengthSquaredLength, lengthSquared, d2yLength, d2y, d2yLength, d2y);
+
+    double negatedEnd = -end;
+    double threshold[32];
+    int thresholdLength = addProduct(0, threshold, lengthSquaredLength, lengthSquared, 1, &negatedEnd);
+
+    length = copyExpansion(t2CrossLength, t2Cross, scaled);
+    length = addProduct(length, scaled, thresholdLength, threshold, crossLength, cross);
+    if(expansionSign(length, scaled) * signCross >= 0)
+        return false;
+
+    t1 = estimateExpansion(numeratorLength, numerator) / estimateExpansion(crossLength, cross);
+    return true;
+}
+
+}
+
+template<typename Scalar>
+struct BasicVertex
 {
+    typedef BasicVec2<Scalar> Vec2;
+
     Vec2 position;
 
-    Vertex() {}
-    Vertex(Vec2 const & _position) : position{_position} {}
+    BasicVertex() {}
+    BasicVertex(Vec2 const & _position) : position{_position} {}
 
-    static float getHandedness(Vertex const & v1,
-                               Vertex const & v2,
-                               Vertex const & v3)
+    static Scalar getHandedness(BasicVertex const & v1,
+                                BasicVertex const & v2,
+                                BasicVertex const & v3)
     {
         Vec2 edge1 = v2.position-v1.position;
         Vec2 edge2 = v3.position-v2.position;
 
         return Vec2::cross(edge1, edge2);
     }
+
+    // Exact sign of getHandedness: 1 for a left turn, -1 for a right turn
+    // and 0 for collinear vertices
+    static int getOrientation(BasicVertex const & v1,
+                              BasicVertex const & v2,
+                              BasicVertex const & v3)
+    {
+        return detail::crossSign(v1.position, v2.position, v2.position, v3.position);
+    }
 };
 
-struct SliceVertex : public Vertex
+template<typename Scalar>
+struct BasicSliceVertex : public BasicVertex<Scalar>
 {
-    SliceVertex() {}
-    SliceVertex(Vec2 const & _position) : Vertex{_position} {}
+    BasicSliceVertex() {}
+    BasicSliceVertex(BasicVec2<Scalar> const & _position) : BasicVertex<Scalar>{_position} {}
 
     int index;
-    float distanceToSlice;
+    Scalar distanceToSlice;
 };
 
-struct LineSegment
+template<typename Scalar>
+struct BasicLineSegment
 {
+    typedef BasicVec2<Scalar> Vec2;
+
     Vec2 startPos;
     Vec2 finalPos;
 
-    LineSegment() {}
-    LineSegment(Vec2 const & _startPos,
-                Vec2 const & _finalPos) : startPos{_startPos},
-                finalPos{_finalPos} {}
+    BasicLineSegment() {}
+    BasicLineSegment(Vec2 const & _startPos,
+                     Vec2 const & _finalPos) : startPos{_startPos},
+                     finalPos{_finalPos} {}
 
     Vec2 direction() const
     {
@@ -114,351 +484,3061 @@ struct LineSegment
         return Vec2::norm(finalPos-startPos);
     }
 
-    LineSegment operator + (LineSegment const & ls)
+    BasicLineSegment operator + (BasicLineSegment const & ls)
     {
         Vec2 newStartPos = (startPos + ls.startPos) / 2.0f;
         Vec2 newFinalPos = (finalPos + ls.finalPos) / 2.0f;
 
-        return LineSegment(newStartPos, newFinalPos);
+        return BasicLineSegment(newStartPos, newFinalPos);
     }
 
-    static std::pair<bool, Vec2> intersects(LineSegment s1, LineSegment s2)
+    // The limits on t1 = numerator / crossDirections and on t2 are tested
+    // after multiplying through by crossDirections, so no division is made
+    // before a hit is certain. Each test runs in floating point first and is
+    // only repeated in exact arithmetic when its value lies within the error
+    // bound, so the result is that of the real valued computation. The
+    // bounds are built from the 1-norms of d1, d2 and p2 - p1, which bound
+    // every product of their coordinates.
+    static std::pair<bool, Vec2> intersects(BasicLineSegment s1, BasicLineSegment s2)
     {
-        const float TOLERANCE = 1e-2;
+        const Scalar TOLERANCE = ScalarTraits<Scalar>::INTERSECTION_TOLERANCE;
+        const Scalar LOWER = 0.0f - TOLERANCE;
+        const Scalar UPPER = 1.0f + TOLERANCE;
+        const Scalar END = 1.0f - TOLERANCE;
+        const Scalar PRODUCT = detail::ErrorBounds<Scalar>::PRODUCT;
 
         Vec2 p1 = s1.startPos;
         Vec2 p2 = s2.startPos;
         Vec2 d1 = s1.direction();
         Vec2 d2 = s2.direction();
+        Vec2 relativePos = p2 - p1;
 
-        if(std::abs(Vec2::cross(d1, d2)) < 1e-30)
-           return {false, {0.0f, 0.0f}};
+        Scalar d1Size = std::abs(d1.x) + std::abs(d1.y);
+        Scalar d2Size = std::abs(d2.x) + std::abs(d2.y);
+        Scalar relativeSize = std::abs(relativePos.x) + std::abs(relativePos.y);
+        Scalar crossBound = PRODUCT * d1Size * d2Size;
 
-        float t1 = Vec2::cross(p2 - p1, d2) / Vec2::cross(d1, d2);
+        Scalar crossDirections = detail::mulSub(d1.x, d2.y, d1.y, d2.x);
+        Scalar numerator = detail::mulSub(relativePos.x, d2.y, relativePos.y, d2.x);
 
-        if((t1 < (0.0f - TOLERANCE)) || (t1 > (1.0f + TOLERANCE)))
+        if(std::abs(crossDirections) <= crossBound)
+        {
+            // Parallel when both products have an exactly zero factor, and
+            // out of range whatever the sign of crossDirections when the
+            // numerator clearly exceeds it
+            bool parallel = (d1.x == 0.0f || d2.y == 0.0f) && (d1.y == 0.0f || d2.x == 0.0f);
+            bool outOfRange = std::abs(numerator) > PRODUCT * d2Size * (relativeSize + 3.0f * d1Size);
+            if(parallel || outOfRange)
+                return {false, {0.0f, 0.0f}};
+
+            return intersectsExact(s1, s2, LOWER, UPPER, END);
+        }
+
+        // t2 = dot(p1 - p2, d2) + t1 * dot(d1, d2), scaled by crossDirections
+        Scalar relativeDot = -detail::mulAdd(relativePos.x, d2.x, relativePos.y, d2.y);
+        Scalar directionDot = detail::mulAdd(d1.x, d2.x, d1.y, d2.y);
+        Scalar t2Cross = detail::mulAdd(relativeDot, crossDirections, numerator * directionDot);
+        Scalar lengthSquared = detail::mulAdd(d2.x, d2.x, d2.y, d2.y);
+
+        // The sign of crossDirections is a coin flip per edge, so it is
+        // folded in without a branch
+        Scalar crossSign = std::copysign(Scalar(1), crossDirections);
+        Scalar absCross = std::abs(crossDirections);
+        Scalar signedNumerator = numerator * crossSign;
+        Scalar signedT2Cross = t2Cross * crossSign;
+
+        Scalar t1LowerGap = signedNumerator - LOWER * absCross;
+        Scalar t1UpperGap = signedNumerator - UPPER * absCross;
+        Scalar t2LowerGap = signedT2Cross - LOWER * absCross;
+        Scalar t2EndGap = signedT2Cross - END * lengthSquared * absCross;
+
+        Scalar t1Bound = 2.0f * PRODUCT * d2Size * (d1Size + relativeSize);
+        Scalar t2LowerBound = crossBound * (7.0f * d2Size * relativeSize + 1.0f);
+        Scalar t2EndBound = crossBound * d2Size * (7.0f * relativeSize + 2.0f * d2Size);
+
+        // Large float coordinates can overflow t2Cross; the exact test runs
+        // in double and still decides them
+        if(!(std::abs(t2Cross) <= std::numeric_limits<Scalar>::max()))
+            return intersectsExact(s1, s2, LOWER, UPPER, END);
+
+        bool miss = (t1LowerGap < -t1Bound) | (t1UpperGap > t1Bound) |
+                    (t2LowerGap < -t2LowerBound) | (t2EndGap >= t2EndBound);
+        if(miss)
             return {false, {0.0f, 0.0f}};
 
-        Vec2 pIntersect = p1 + d1 * t1;
+        bool uncertain = (t1LowerGap <= t1Bound) | (t1UpperGap >= -t1Bound) |
+                         (t2LowerGap <= t2LowerBound) | (t2EndGap >= -t2EndBound);
+        if(uncertain)
+            return intersectsExact(s1, s2, LOWER, UPPER, END);
+
+        Scalar t1 = numerator / crossDirections;
 
-        float t2 = Vec2::dot(pIntersect - p2,
-                             s2.finalPos - p2);
+        return {true, {detail::mulAdd(d1.x, t1, p1.x),
+                       detail::mulAdd(d1.y, t1, p1.y)}};
+    }
 
-        if(t2 < (0.0f-TOLERANCE) || t2 / Vec2::square(s2.finalPos - p2) >= 1.0f - TOLERANCE)
+    static std::pair<bool, Vec2> intersectsExact(BasicLineSegment const & s1,
+                                                 BasicLineSegment const & s2,
+                                                 Scalar lower,
+                                                 Scalar upper,
+                                                 Scalar end)
+    {
+        double t1;
+        if(detail::exactIntersection(s1.startPos.x, s1.startPos.y, s1.finalPos.x, s1.finalPos.y,
+                                     s2.startPos.x, s2.startPos.y, s2.finalPos.x, s2.finalPos.y,
+                                     lower, upper, end, t1) == false)
             return {false, {0.0f, 0.0f}};
 
-        return {true, pIntersect};
+        Vec2 d1 = s1.direction();
+        return {true, {detail::mulAdd(d1.x, (Scalar)t1, s1.startPos.x),
+                       detail::mulAdd(d1.y, (Scalar)t1, s1.startPos.y)}};
     }
 };
 
-class ConcavePolygon
-{
-    typedef std::vector<Vertex > VertexArray;
-    typedef std::vector<ConcavePolygon > PolygonArray;
-
-    VertexArray vertices;
-    PolygonArray subPolygons;
+typedef BasicVec2<double> Vec2;
+typedef BasicVertex<double> Vertex;
+typedef BasicSliceVertex<double> SliceVertex;
+typedef BasicLineSegment<double> LineSegment;
 
+typedef BasicVec2<float> Vec2f;
+typedef BasicVertex<float> Vertexf;
+typedef BasicSliceVertex<float> SliceVertexf;
+typedef BasicLineSegment<float> LineSegmentf;
 
-    int mod(int x, int m)
+// Work counters for decomposition and slicing. They are only collected
+// when CXD_ENABLE_STATS is defined before including this header; otherwise
+// every hook compiles away and the counters stay at zero.
+struct DecompStats
+{
+    unsigned long long reflexVerticesFound;
+    unsigned long long visibilityTests;
+    unsigned long long edgeIntersectionTests;
+    unsigned long long slicesPerformed;
+    unsigned long long verticesCopied;
+    unsigned long long subtreesCulled;
+    unsigned long long piecesMerged;
+
+    double reflexSearchSeconds;
+    double cutSearchSeconds;
+    double sliceSeconds;
+
+    DecompStats()
     {
-        int r = x%m;
-        return r<0 ? r+m : r;
+        reset();
     }
 
-    void flipPolygon(VertexArray & _verts)
+    void reset()
     {
-        int iMax = _verts.size()/2;
-
-        if(_verts.size() % 2 != 0)
-            iMax += 1;
-
-        for(int i=1; i<iMax; ++i)
-        {
-            std::swap(_verts[i], _verts[_verts.size()-i]);
-        }
+        reflexVerticesFound = 0;
+        visibilityTests = 0;
+        edgeIntersectionTests = 0;
+        slicesPerformed = 0;
+        verticesCopied = 0;
+        subtreesCulled = 0;
+        piecesMerged = 0;
+
+        reflexSearchSeconds = 0.0;
+        cutSearchSeconds = 0.0;
+        sliceSeconds = 0.0;
     }
 
-    bool checkIfRightHanded(VertexArray & _verts)
+    void merge(DecompStats const & other)
     {
-        if(_verts.size() < 3)
-            return false;
-
-        float signedArea = 0.0f;
-
-        for(unsigned int i=0; i<_verts.size(); ++i)
-        {
-            signedArea += Vec2::getSignedArea(_verts[i].position,
-                                                   _verts[mod(i+1, _verts.size())].position);
-        }
-
-        if(signedArea < 0.0f)
-            return true;
-
-        return false;
+        reflexVerticesFound += other.reflexVerticesFound;
+        visibilityTests += other.visibilityTests;
+        edgeIntersectionTests += other.edgeIntersectionTests;
+        slicesPerformed += other.slicesPerformed;
+        verticesCopied += other.verticesCopied;
+        subtreesCulled += other.subtreesCulled;
+        piecesMerged += other.piecesMerged;
+
+        reflexSearchSeconds += other.reflexSearchSeconds;
+        cutSearchSeconds += other.cutSearchSeconds;
+        sliceSeconds += other.sliceSeconds;
     }
+};
 
+namespace detail
+{
 
+inline DecompStats * & activeStats()
+{
+    static thread_local DecompStats * stats = nullptr;
+    return stats;
+}
 
-    bool isVertexInCone(LineSegment const & ls1,
-                        LineSegment const & ls2,
-                        Vec2 const & origin,
-                        Vertex const & vert)
-    {
-        Vec2 relativePos = vert.position - origin;
-
-        float ls1Product = Vec2::cross(relativePos, ls1.direction());
-        float ls2Product = Vec2::cross(relativePos, ls2.direction());
+inline DecompStats & threadLastStats()
+{
+    static thread_local DecompStats stats;
+    return stats;
+}
 
-        if(ls1Product < 0.0f && ls2Product > 0.0f)
-            return true;
+}
 
-        return false;
-    }
+// Counters of the most recent top level decomposition or slicing call
+// made on this thread.
+inline DecompStats const & lastDecompStats()
+{
+    return detail::threadLastStats();
+}
 
-    typedef std::vector<int > IntArray;
+// Routes counters to a sink for its lifetime. The default form is used by
+// public entry points: the outermost one resets and fills lastDecompStats(),
+// nested ones leave the active sink alone. Passing a target redirects the
+// counters, which parallel code uses to gather per-task counts.
+class StatsScope
+{
+    DecompStats * previous;
+    bool installed;
 
-    IntArray findVerticesInCone(LineSegment const & ls1,
-                                   LineSegment const & ls2,
-                                   Vec2 const & origin,
-                                   VertexArray const & inputVerts)
+public:
+    StatsScope() : previous{detail::activeStats()}, installed{false}
     {
-        IntArray result;
-
-        for(unsigned int i=0; i<inputVerts.size(); ++i)
+        if(previous == nullptr)
         {
-            if(isVertexInCone(ls1, ls2, origin, inputVerts[i]))
-                result.push_back(i);
+            detail::threadLastStats().reset();
+            detail::activeStats() = &detail::threadLastStats();
+            installed = true;
         }
-        return result;
     }
 
-    bool checkVisibility(Vec2 const & originalPosition,
-                         Vertex const & vert,
-                         VertexArray const & polygonVertices)
+    explicit StatsScope(DecompStats & target) : previous{detail::activeStats()},
+        installed{true}
     {
-        LineSegment ls(originalPosition, vert.position);
-        VertexIntMap intersectingVerts = verticesAlongLineSegment(ls, polygonVertices);
+        detail::activeStats() = &target;
+    }
 
-        std::cout << intersectingVerts.size() << " intverts\n";
+    ~StatsScope()
+    {
+        if(installed)
+            detail::activeStats() = previous;
+    }
 
-        if(intersectingVerts.size() > 3)
-            return false;
+    StatsScope(StatsScope const &) = delete;
+    StatsScope & operator = (StatsScope const &) = delete;
+};
 
-        return true;
-    }
+#ifdef CXD_ENABLE_STATS
+
+class PhaseTimer
+{
+    double DecompStats::* phase;
+    std::chrono::steady_clock::time_point start;
 
+public:
+    explicit PhaseTimer(double DecompStats::* _phase) : phase{_phase},
+        start{std::chrono::steady_clock::now()} {}
 
-    int getBestVertexToConnect(IntArray const & indices,
-                               VertexArray const & polygonVertices,
-                               Vec2 const & origin)
+    ~PhaseTimer()
     {
-        if(indices.size()==1)
+        if(DecompStats * stats = detail::activeStats())
         {
-            if(checkVisibility(origin, polygonVertices[indices[0]], polygonVertices))
-                return indices[0];
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            stats->*phase += elapsed.count();
         }
-        else if(indices.size() > 1)
-        {
-            for(unsigned int i=0; i<indices.size(); ++i)
-            {
-                int index = indices[i];
-                int vertSize = polygonVertices.size();
+    }
+};
 
-                Vertex prevVert = polygonVertices[mod(index-1, vertSize)].position;
-                Vertex currVert = polygonVertices[index].position;
-                Vertex nextVert = polygonVertices[mod(index+1, vertSize)].position;
+#define CXD_STATS_SCOPE() cxd::StatsScope cxdStatsScope
+#define CXD_STATS_ADD(counter, amount) \
+    do { if(cxd::DecompStats * cxdStats = cxd::detail::activeStats()) \
+             cxdStats->counter += (amount); } while(0)
+#define CXD_STATS_PHASE(phase) cxd::PhaseTimer cxdPhaseTimer(&cxd::DecompStats::phase)
 
-                LineSegment ls1(prevVert.position, currVert.position);
-                LineSegment ls2(nextVert.position, currVert.position);
+#else
 
-                if((Vertex::getHandedness(prevVert, currVert, nextVert) < 0.0f) &&
-                   isVertexInCone(ls1, ls2, polygonVertices[index].position, Vertex(origin)) &&
-                   checkVisibility(origin, polygonVertices[index], polygonVertices))
-                    return index;
-            }
+#define CXD_STATS_SCOPE() ((void)0)
+#define CXD_STATS_ADD(counter, amount) ((void)0)
+#define CXD_STATS_PHASE(phase) ((void)0)
 
-            for(unsigned int i=0; i<indices.size(); ++i)
-            {
-                int index = indices[i];
-                int vertSize = polygonVertices.size();
+#endif
 
-                Vertex prevVert = polygonVertices[mod(index-1, vertSize)].position;
-                Vertex currVert = polygonVertices[index].position;
-                Vertex nextVert = polygonVertices[mod(index+1, vertSize)].position;
+template<typename T>
+struct Span
+{
+    T * ptr;
+    std::size_t length;
 
-                LineSegment ls1(prevVert.position, currVert.position);
-                LineSegment ls2(nextVert.position, currVert.position);
+    Span() : ptr{nullptr}, length{0} {}
+    Span(T * _ptr, std::size_t _length) : ptr{_ptr}, length{_length} {}
 
-                if((Vertex::getHandedness(prevVert, currVert, nextVert) < 0.0f) &&
-                   checkVisibility(origin, polygonVertices[index], polygonVertices))
-                    return index;
-            }
+    template<typename Container>
+    Span(Container & container) : ptr{container.data()},
+        length{container.size()} {}
 
+    T * data() const { return ptr; }
+    T * begin() const { return ptr; }
+    T * end() const { return ptr + length; }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
 
-            float minDistance = 1e+15;
-            int closest = indices[0];
-            for(unsigned int i=0; i<indices.size(); ++i)
-            {
-                int index = indices[i];
-                float currDistance = Vec2::square(polygonVertices[index].position - origin);
-                if(currDistance < minDistance)
-                {
-                    minDistance = currDistance;
-                    closest = index;
-                }
-            }
+    T & operator [] (std::size_t index) const
+    {
+        return ptr[index];
+    }
+};
 
-            return closest;
-        }
+template<typename Scalar>
+using BasicVertexSpan = Span<BasicVertex<Scalar> const>;
 
+typedef BasicVertexSpan<double> VertexSpan;
 
-        return -1;
+// Axis aligned box used to cull slices. aroundEdges grows the box of a
+// polygon's vertices by the stretch LineSegment::intersects allows before
+// the start of every edge, so a segment that misses the box cannot hit
+// any of the edges.
+template<typename Scalar>
+struct BasicBoundingBox
+{
+    typedef BasicVec2<Scalar> Vec2;
+
+    Vec2 lower;
+    Vec2 upper;
+
+    BasicBoundingBox() : lower{std::numeric_limits<Scalar>::infinity(),
+                               std::numeric_limits<Scalar>::infinity()},
+                         upper{-std::numeric_limits<Scalar>::infinity(),
+                               -std::numeric_limits<Scalar>::infinity()} {}
+
+    void expand(Vec2 const & point)
+    {
+        lower = {std::min(lower.x, point.x), std::min(lower.y, point.y)};
+        upper = {std::max(upper.x, point.x), std::max(upper.y, point.y)};
     }
 
-    void convexDecomp(VertexArray const & _vertices)
+    void expand(BasicBoundingBox const & box)
     {
-        if(subPolygons.size() > 0)
-        {
-            return;
-        }
+        lower = {std::min(lower.x, box.lower.x), std::min(lower.y, box.lower.y)};
+        upper = {std::max(upper.x, box.upper.x), std::max(upper.y, box.upper.y)};
+    }
 
-        int reflexIndex = findFirstReflexVertex(_vertices);
-        if(reflexIndex == -1)
-            return;
+    static BasicBoundingBox aroundEdges(BasicVertexSpan<Scalar> _vertices)
+    {
+        // Twice the tolerance covers the rounding of the stretch itself
+        const Scalar STRETCH = 2.0f * ScalarTraits<Scalar>::INTERSECTION_TOLERANCE;
+        const Scalar INFINITE = std::numeric_limits<Scalar>::infinity();
 
-        Vec2 prevVertPos = _vertices[mod(reflexIndex-1, _vertices.size())].position;
-        Vec2 currVertPos = _vertices[reflexIndex].position;
-        Vec2 nextVertPos = _vertices[mod(reflexIndex+1, _vertices.size())].position;
+        BasicBoundingBox box;
+        unsigned int numVertices = _vertices.size();
 
-        LineSegment ls1(prevVertPos, currVertPos);
-        LineSegment ls2(nextVertPos, currVertPos);
+        for(unsigned int i=0; i<numVertices; ++i)
+        {
+            Vec2 startPos = _vertices[i].position;
+            Vec2 edge = _vertices[(i+1) % numVertices].position - startPos;
+            Scalar lengthSquared = edge.x*edge.x + edge.y*edge.y;
 
-        IntArray vertsInCone = findVerticesInCone(ls1, ls2, currVertPos, _vertices);
+            box.expand(startPos);
 
-        int bestVert = -1;
+            // Zero length edges are never hit
+            if(lengthSquared == 0.0f)
+                continue;
 
-        if(vertsInCone.size() > 0)
-        {
-            bestVert = getBestVertexToConnect(vertsInCone, _vertices, currVertPos);
-            if(bestVert != -1)
+            Scalar stretch = STRETCH / lengthSquared;
+            if(!(stretch <= std::numeric_limits<Scalar>::max()))
             {
-                LineSegment newLine(currVertPos, _vertices[bestVert].position);
-
-                slicePolygon(newLine);
+                box.lower = {-INFINITE, -INFINITE};
+                box.upper = {INFINITE, INFINITE};
+                return box;
             }
-        }
-        if(vertsInCone.size() == 0 || bestVert == -1)
-        {
-            LineSegment newLine(currVertPos, (ls1.direction() + ls2.direction()) * 1e+10);
-            slicePolygon(newLine);
-        }
 
-        for(unsigned int i=0; i<subPolygons.size(); ++i)
-        {
-            subPolygons[i].convexDecomp();
+            box.expand(Vec2{startPos.x - edge.x * stretch, startPos.y - edge.y * stretch});
         }
-    }
 
-    int findFirstReflexVertex(VertexArray const & _vertices)
-    {
-        for(unsigned int i=0; i<_vertices.size(); ++i)
+        if(numVertices > 0)
         {
-            float handedness = Vertex::getHandedness(_vertices[mod(i-1, _vertices.size())],
-                                                     _vertices[i],
-                                                     _vertices[mod(i+1, _vertices.size())]);
-            if(handedness < 0.0f)
-                return i;
+            Scalar magnitude = std::max(std::max(std::abs(box.lower.x), std::abs(box.upper.x)),
+                                        std::max(std::abs(box.lower.y), std::abs(box.upper.y)));
+            Scalar margin = detail::ErrorBounds<Scalar>::PRODUCT * magnitude;
+            box.lower = box.lower - Vec2{margin, margin};
+            box.upper = box.upper + Vec2{margin, margin};
         }
 
-        return -1;
+        return box;
     }
 
-    void flipPolygon()
+    // False only when no point of the segment, stretched by the
+    // intersection tolerance, can lie in the box: either the boxes are
+    // disjoint or every corner is clearly on one side of the segment's line.
+    bool mayIntersect(BasicLineSegment<Scalar> const & segment) const
     {
-        flipPolygon(vertices);
-    }
-
-    typedef std::map<int, Vertex> VertexIntMap;
-    typedef std::pair<int, Vertex> VertexIntPair;
+        const Scalar STRETCH = 2.0f * ScalarTraits<Scalar>::INTERSECTION_TOLERANCE;
+        const Scalar PRODUCT = detail::ErrorBounds<Scalar>::PRODUCT;
 
+        Vec2 direction = segment.direction();
+        Vec2 extension = direction * STRETCH;
+        Vec2 startPos = segment.startPos - extension;
+        Vec2 finalPos = segment.finalPos + extension;
 
-    VertexIntMap cullByDistance(VertexIntMap const & input,
-                                Vec2 const & origin,
-                                int const & maxVertsToKeep)
-    {
-        if(maxVertsToKeep >= (int)input.size())
-            return input;
+        if(std::max(startPos.x, finalPos.x) < lower.x || std::min(startPos.x, finalPos.x) > upper.x ||
+           std::max(startPos.y, finalPos.y) < lower.y || std::min(startPos.y, finalPos.y) > upper.y)
+            return false;
 
-        std::vector<SliceVertex > sliceVertices;
+        Vec2 corners[4] = {lower, {upper.x, lower.y}, upper, {lower.x, upper.y}};
+        int above = 0;
+        int below = 0;
 
-        for(auto it = input.begin(); it != input.end(); ++it)
+        for(int i=0; i<4; ++i)
         {
-            SliceVertex vert(it->second.position);
-            vert.index = it->first;
-            vert.distanceToSlice = Vec2::square(it->second.position - origin);
+            Vec2 relativePos = corners[i] - segment.startPos;
+            Scalar left = direction.x * relativePos.y;
+            Scalar right = direction.y * relativePos.x;
+            Scalar bound = 2.0f * PRODUCT * (std::abs(left) + std::abs(right));
 
-            sliceVertices.push_back(vert);
+            above += (left - right > bound);
+            below += (right - left > bound);
         }
 
-        for(unsigned int i=1; i<sliceVertices.size(); ++i)
-            for(unsigned int j=i; j > 0 && sliceVertices[j].distanceToSlice < sliceVertices[j-1].distanceToSlice; --j)
-                std::swap(sliceVertices[j], sliceVertices[j-1]);
+        return above < 4 && below < 4;
+    }
+};
 
-        sliceVertices.erase(sliceVertices.begin()+maxVertsToKeep, sliceVertices.end());
+typedef BasicBoundingBox<double> BoundingBox;
+typedef BasicBoundingBox<float> BoundingBoxf;
 
-        for(unsigned int i=1; i<sliceVertices.size(); ++i)
-            for(unsigned int j=i; j > 0 && sliceVertices[j].index < sliceVertices[j-1].index; --j)
-                std::swap(sliceVertices[j], sliceVertices[j-1]);
+// Which reflex vertex a decomposition step resolves first.
+enum class ReflexOrder
+{
+    First,      // lowest vertex index, the original behaviour
+    Sharpest    // largest turn angle, tends to give fewer slivers
+};
 
-        VertexIntMap result;
-        for(unsigned int i=0; i<sliceVertices.size(); ++i)
-        {
-            result.insert({sliceVertices[i].index, Vertex(sliceVertices[i].position)});
-        }
+// How a decomposition step picks the vertex a reflex vertex connects to.
+enum class CutSearch
+{
+    BestQuality,    // test candidates in index order until one is visible
+    Bounded         // test the nearest candidates first, at most
+                    // maxVisibilityTests of them
+};
 
-        return result;
-    }
+// Options shared by the decomposition entry points.
+struct DecompOptions
+{
+    ReflexOrder reflexOrder;
+
+    // Frees the vertex arrays of sub polygon tree nodes as soon as they
+    // are sliced, as ConcavePolygon::compact does afterwards.
+    bool compactTree;
+
+    // Every visibility test costs a scan of the piece's edges. Bounded
+    // caps them per reflex vertex and falls back to the closest candidate,
+    // so the work per step no longer grows with the number of candidates.
+    CutSearch cutSearch;
+    unsigned int maxVisibilityTests;
+
+    // Runs ConvexDecomposition::mergePieces before a flat result is
+    // filled, so cuts that are not needed for convexity are undone. The
+    // sub polygon tree is binary and is never merged.
+    bool mergePieces;
+
+    DecompOptions() : reflexOrder{ReflexOrder::First}, compactTree{false},
+        cutSearch{CutSearch::BestQuality}, maxVisibilityTests{8},
+        mergePieces{false} {}
+};
 
-    VertexIntMap verticesAlongLineSegment(LineSegment const & segment,
-                                          VertexArray const & _vertices)
-    {
-        VertexIntMap result;
+// Tolerances of ConcavePolygon::simplify, in the polygon's units. Each
+// step runs in the order listed and is skipped if it would leave fewer
+// than three vertices.
+struct SimplifyOptions
+{
+    // Vertices this close to the previous kept vertex are merged into it.
+    // 0 merges exact duplicates only.
+    double weldDistance;
+
+    // Vertices this close to the line through their neighbours, and
+    // between them, are dropped. 0 drops exactly collinear vertices only.
+    double collinearDistance;
+
+    // Douglas-Peucker simplification keeping every removed vertex within
+    // this distance of the new outline. 0 disables it. The outline is not
+    // checked for self intersection, so keep this below the narrowest
+    // feature of the polygon.
+    double maxError;
+
+    SimplifyOptions() : weldDistance{0.0}, collinearDistance{0.0},
+        maxError{0.0} {}
+};
 
-        LineSegment tempSegment;
+namespace detail
+{
 
-        for(unsigned int i=0; i<_vertices.size(); ++i)
+// Thin wrappers over the vector instructions used by the intersection
+// kernel, one specialisation per scalar type and instruction set.
+// flipSign(a, b) negates a in the lanes where b is negative.
+template<typename Scalar>
+struct SimdOps;
+
+#if defined(CXD_SIMD_AVX)
+
+template<>
+struct SimdOps<double>
+{
+    typedef __m256d Register;
+    static const int LANES = 4;
+
+    static Register set(double value) { return _mm256_set1_pd(value); }
+    static Register load(double const * values) { return _mm256_loadu_pd(values); }
+    static Register add(Register a, Register b) { return _mm256_add_pd(a, b); }
+    static Register sub(Register a, Register b) { return _mm256_sub_pd(a, b); }
+    static Register mul(Register a, Register b) { return _mm256_mul_pd(a, b); }
+    static Register div(Register a, Register b) { return _mm256_div_pd(a, b); }
+    static Register abs(Register a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+    static Register either(Register a, Register b) { return _mm256_or_pd(a, b); }
+    static Register both(Register a, Register b) { return _mm256_and_pd(a, b); }
+    static Register flipSign(Register a, Register b) { return _mm256_xor_pd(a, _mm256_and_pd(b, _mm256_set1_pd(-0.0))); }
+    static Register less(Register a, Register b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static Register greater(Register a, Register b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static Register greaterEqual(Register a, Register b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static unsigned int bits(Register a) { return _mm256_movemask_pd(a); }
+#ifdef __FMA__
+    static Register fusedMulSub(Register a, Register b, Register c) { return _mm256_fmsub_pd(a, b, c); }
+    static Register fusedMulAdd(Register a, Register b, Register c) { return _mm256_fmadd_pd(a, b, c); }
+#endif
+};
+
+template<>
+struct SimdOps<float>
+{
+    typedef __m256 Register;
+    static const int LANES = 8;
+
+    static Register set(float value) { return _mm256_set1_ps(value); }
+    static Register load(float const * values) { return _mm256_loadu_ps(values); }
+    static Register add(Register a, Register b) { return _mm256_add_ps(a, b); }
+    static Register sub(Register a, Register b) { return _mm256_sub_ps(a, b); }
+    static Register mul(Register a, Register b) { return _mm256_mul_ps(a, b); }
+    static Register div(Register a, Register b) { return _mm256_div_ps(a, b); }
+    static Register abs(Register a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static Register either(Register a, Register b) { return _mm256_or_ps(a, b); }
+    static Register both(Register a, Register b) { return _mm256_and_ps(a, b); }
+    static Register flipSign(Register a, Register b) { return _mm256_xor_ps(a, _mm256_and_ps(b, _mm256_set1_ps(-0.0f))); }
+    static Register less(Register a, Register b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Register greater(Register a, Register b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Register greaterEqual(Register a, Register b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static unsigned int bits(Register a) { return _mm256_movemask_ps(a); }
+#ifdef __FMA__
+    static Register fusedMulSub(Register a, Register b, Register c) { return _mm256_fmsub_ps(a, b, c); }
+    static Register fusedMulAdd(Register a, Register b, Register c) { return _mm256_fmadd_ps(a, b, c); }
+#endif
+};
+
+#elif defined(CXD_SIMD_SSE2)
+
+template<>
+struct SimdOps<double>
+{
+    typedef __m128d Register;
+    static const int LANES = 2;
+
+    static Register set(double value) { return _mm_set1_pd(value); }
+    static Register load(double const * values) { return _mm_loadu_pd(values); }
+    static Register add(Register a, Register b) { return _mm_add_pd(a, b); }
+    static Register sub(Register a, Register b) { return _mm_sub_pd(a, b); }
+    static Register mul(Register a, Register b) { return _mm_mul_pd(a, b); }
+    static Register div(Register a, Register b) { return _mm_div_pd(a, b); }
+    static Register abs(Register a) { return _mm_andnot_pd(_mm_set1_pd(-0.0), a); }
+    static Register either(Register a, Register b) { return _mm_or_pd(a, b); }
+    static Register both(Register a, Register b) { return _mm_and_pd(a, b); }
+    static Register flipSign(Register a, Register b) { return _mm_xor_pd(a, _mm_and_pd(b, _mm_set1_pd(-0.0))); }
+    static Register less(Register a, Register b) { return _mm_cmplt_pd(a, b); }
+    static Register greater(Register a, Register b) { return _mm_cmpgt_pd(a, b); }
+    static Register greaterEqual(Register a, Register b) { return _mm_cmpge_pd(a, b); }
+    static unsigned int bits(Register a) { return _mm_movemask_pd(a); }
+};
+
+template<>
+struct SimdOps<float>
+{
+    typedef __m128 Register;
+    static const int LANES = 4;
+
+    static Register set(float value) { return _mm_set1_ps(value); }
+    static Register load(float const * values) { return _mm_loadu_ps(values); }
+    static Register add(Register a, Register b) { return _mm_add_ps(a, b); }
+    static Register sub(Register a, Register b) { return _mm_sub_ps(a, b); }
+    static Register mul(Register a, Register b) { return _mm_mul_ps(a, b); }
+    static Register div(Register a, Register b) { return _mm_div_ps(a, b); }
+    static Register abs(Register a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static Register either(Register a, Register b) { return _mm_or_ps(a, b); }
+    static Register both(Register a, Register b) { return _mm_and_ps(a, b); }
+    static Register flipSign(Register a, Register b) { return _mm_xor_ps(a, _mm_and_ps(b, _mm_set1_ps(-0.0f))); }
+    static Register less(Register a, Register b) { return _mm_cmplt_ps(a, b); }
+    static Register greater(Register a, Register b) { return _mm_cmpgt_ps(a, b); }
+    static Register greaterEqual(Register a, Register b) { return _mm_cmpge_ps(a, b); }
+    static unsigned int bits(Register a) { return _mm_movemask_ps(a); }
+};
+
+#endif
+
+// True when cross(position - origin, ls1 direction) < 0 and
+// cross(position - origin, ls2 direction) > 0, decided exactly.
+template<typename Scalar>
+inline bool isVertexInCone(BasicLineSegment<Scalar> const & ls1,
+                           BasicLineSegment<Scalar> const & ls2,
+                           BasicVec2<Scalar> const & origin,
+                           BasicVec2<Scalar> const & position)
+{
+    int ls1Product = filteredCrossSign(origin, position, ls1.startPos, ls1.finalPos);
+    int ls2Product = filteredCrossSign(origin, position, ls2.startPos, ls2.finalPos);
+
+    // The filters decide nearly every vertex; only the rest pay for the
+    // exact test
+    if(ls1Product == 0)
+        ls1Product = crossSign(origin, position, ls1.startPos, ls1.finalPos);
+    if(ls2Product == 0)
+        ls2Product = crossSign(origin, position, ls2.startPos, ls2.finalPos);
+
+    return ls1Product < 0 && ls2Product > 0;
+}
+
+}
+
+// Polygon coordinates split into x and y arrays, so the intersection
+// kernel can test a full vector register of edges per instruction. Both
+// arrays repeat the first vertex at the end, so edge i always reads
+// entries i and i+1.
+template<typename Scalar, typename Allocator = std::allocator<Scalar> >
+class EdgeCoordinates
+{
+    typedef BasicVec2<Scalar> Vec2;
+    typedef BasicLineSegment<Scalar> LineSegment;
+    typedef typename std::allocator_traits<Allocator>::template rebind_alloc<Scalar> ScalarAllocator;
+
+    std::vector<Scalar, ScalarAllocator> xs;
+    std::vector<Scalar, ScalarAllocator> ys;
+
+    template<typename HitHandler>
+    bool reportHit(LineSegment const & segment,
+                   unsigned int edgeIndex,
+                   HitHandler const & onHit) const
+    {
+        std::pair<bool, Vec2 > intersectionResult = LineSegment::intersects(segment, getEdge(edgeIndex));
+
+        if(intersectionResult.first == true)
+            return onHit((int)edgeIndex, intersectionResult.second);
+
+        return true;
+    }
+
+public:
+    explicit EdgeCoordinates(Allocator const & allocator = Allocator()) :
+        xs(ScalarAllocator(allocator)), ys(ScalarAllocator(allocator)) {}
+
+    void assign(BasicVertexSpan<Scalar> _vertices)
+    {
+        xs.resize(_vertices.size() + 1);
+        ys.resize(_vertices.size() + 1);
+
+        for(unsigned int i=0; i<_vertices.size(); ++i)
+        {
+            xs[i] = _vertices[i].position.x;
+            ys[i] = _vertices[i].position.y;
+        }
+
+        xs.back() = xs[0];
+        ys.back() = ys[0];
+    }
+
+    unsigned int getNumberEdges() const
+    {
+        return xs.size() > 1 ? xs.size() - 1 : 0;
+    }
+
+    LineSegment getEdge(unsigned int edgeIndex) const
+    {
+        return LineSegment({xs[edgeIndex], ys[edgeIndex]},
+                           {xs[edgeIndex+1], ys[edgeIndex+1]});
+    }
+
+#if defined(CXD_SIMD_AVX) || defined(CXD_SIMD_SSE2)
+    typedef detail::SimdOps<Scalar> Ops;
+    typedef typename Ops::Register Register;
+
+    // Fused exactly where detail::mulSub and detail::mulAdd are
+    static Register mulSub(Register a, Register b, Register c, Register d)
+    {
+#ifdef __FMA__
+        return Ops::fusedMulSub(a, b, Ops::mul(c, d));
+#else
+        return Ops::sub(Ops::mul(a, b), Ops::mul(c, d));
+#endif
+    }
+
+    static Register mulAdd(Register a, Register b, Register c, Register d)
+    {
+#ifdef __FMA__
+        return Ops::fusedMulAdd(a, b, Ops::mul(c, d));
+#else
+        return Ops::add(Ops::mul(a, b), Ops::mul(c, d));
+#endif
+    }
+
+    static Register mulAdd(Register a, Register b, Register c)
+    {
+#ifdef __FMA__
+        return Ops::fusedMulAdd(a, b, c);
+#else
+        return Ops::add(Ops::mul(a, b), c);
+#endif
+    }
+
+    // Bit k is set unless the segment certainly misses edge first+k. Every
+    // step mirrors the floating point filter of LineSegment::intersects, and
+    // a lane is only cleared when its error bounds prove the miss, so the
+    // exact decision on the set lanes is left to intersects itself.
+    unsigned int candidateMask(LineSegment const & segment,
+                               unsigned int first) const
+    {
+        const Scalar TOLERANCE = ScalarTraits<Scalar>::INTERSECTION_TOLERANCE;
+        const Scalar PRODUCT = detail::ErrorBounds<Scalar>::PRODUCT;
+
+        Vec2 direction = segment.direction();
+        Scalar directionSize = std::abs(direction.x) + std::abs(direction.y);
+
+        Register px = Ops::set(segment.startPos.x);
+        Register py = Ops::set(segment.startPos.y);
+        Register dx = Ops::set(direction.x);
+        Register dy = Ops::set(direction.y);
+        Register lower = Ops::set(0.0f - TOLERANCE);
+        Register zero = Ops::set(0.0f);
+        Register seven = Ops::set(7.0f);
+
+        Register ax = Ops::load(xs.data() + first);
+        Register ay = Ops::load(ys.data() + first);
+        Register edgeX = Ops::sub(Ops::load(xs.data() + first + 1), ax);
+        Register edgeY = Ops::sub(Ops::load(ys.data() + first + 1), ay);
+        Register relativeX = Ops::sub(ax, px);
+        Register relativeY = Ops::sub(ay, py);
+
+        Register edgeSize = Ops::add(Ops::abs(edgeX), Ops::abs(edgeY));
+        Register relativeSize = Ops::add(Ops::abs(relativeX), Ops::abs(relativeY));
+        Register crossBound = Ops::mul(Ops::set(PRODUCT * directionSize), edgeSize);
+
+        Register crossDirections = mulSub(dx, edgeY, dy, edgeX);
+        Register absCross = Ops::abs(crossDirections);
+        Register certain = Ops::greater(absCross, crossBound);
+        Register finite = Ops::set(std::numeric_limits<Scalar>::max());
+
+        Register numerator = mulSub(relativeX, edgeY, relativeY, edgeX);
+        Register relativeDot = Ops::sub(zero, mulAdd(relativeX, edgeX, relativeY, edgeY));
+        Register directionDot = mulAdd(dx, edgeX, dy, edgeY);
+        Register t2Cross = mulAdd(relativeDot, crossDirections, Ops::mul(numerator, directionDot));
+        Register lengthSquared = mulAdd(edgeX, edgeX, edgeY, edgeY);
+
+        certain = Ops::both(certain, Ops::less(Ops::abs(t2Cross), finite));
+
+        Register signedNumerator = Ops::flipSign(numerator, crossDirections);
+        Register signedT2Cross = Ops::flipSign(t2Cross, crossDirections);
+
+        Register t1Bound = Ops::mul(Ops::mul(Ops::set(2.0f * PRODUCT), edgeSize),
+                                    Ops::add(Ops::set(directionSize), relativeSize));
+        Register t2LowerBound = Ops::mul(crossBound, mulAdd(Ops::mul(seven, edgeSize), relativeSize, Ops::set(1.0f)));
+        Register t2EndBound = Ops::mul(Ops::mul(crossBound, edgeSize),
+                                       mulAdd(seven, relativeSize, Ops::add(edgeSize, edgeSize)));
+
+        Register t2EndGap = Ops::sub(signedT2Cross, Ops::mul(Ops::mul(Ops::set(1.0f - TOLERANCE), lengthSquared), absCross));
+
+        Register miss = Ops::less(Ops::sub(signedNumerator, Ops::mul(lower, absCross)), Ops::sub(zero, t1Bound));
+        miss = Ops::either(miss, Ops::greater(Ops::sub(signedNumerator, Ops::mul(Ops::set(1.0f + TOLERANCE), absCross)), t1Bound));
+        miss = Ops::either(miss, Ops::less(Ops::sub(signedT2Cross, Ops::mul(lower, absCross)), Ops::sub(zero, t2LowerBound)));
+        miss = Ops::either(miss, Ops::greaterEqual(t2EndGap, t2EndBound));
+
+        Register nearlyParallel = Ops::greaterEqual(crossBound, absCross);
+        Register outOfRange = Ops::greater(Ops::abs(numerator),
+                                           Ops::mul(Ops::mul(Ops::set(PRODUCT), edgeSize),
+                                                    mulAdd(Ops::set(3.0f), Ops::set(directionSize), relativeSize)));
+
+        Register rejected = Ops::either(Ops::both(certain, miss),
+                                        Ops::both(nearlyParallel, outOfRange));
+
+        return ~Ops::bits(rejected) & ((1u << Ops::LANES) - 1);
+    }
+
+    // Classifies vertices first to first+LANES-1 with the floating point
+    // filter of detail::isVertexInCone. Bit k of the result is set when
+    // vertex first+k is certainly inside the cone, bit k of uncertain when
+    // the filter cannot tell.
+    unsigned int coneMask(Vec2 const & origin,
+                          Vec2 const & direction1,
+                          Vec2 const & direction2,
+                          unsigned int first,
+                          unsigned int & uncertain) const
+    {
+        Register product = Ops::set(detail::ErrorBounds<Scalar>::PRODUCT);
+        Register zero = Ops::set(0.0f);
+
+        Register relativeX = Ops::sub(Ops::load(xs.data() + first), Ops::set(origin.x));
+        Register relativeY = Ops::sub(Ops::load(ys.data() + first), Ops::set(origin.y));
+
+        Register left1 = Ops::mul(relativeX, Ops::set(direction1.y));
+        Register right1 = Ops::mul(relativeY, Ops::set(direction1.x));
+        Register cross1 = Ops::sub(left1, right1);
+        Register bound1 = Ops::mul(product, Ops::add(Ops::abs(left1), Ops::abs(right1)));
+
+        Register left2 = Ops::mul(relativeX, Ops::set(direction2.y));
+        Register right2 = Ops::mul(relativeY, Ops::set(direction2.x));
+        Register cross2 = Ops::sub(left2, right2);
+        Register bound2 = Ops::mul(product, Ops::add(Ops::abs(left2), Ops::abs(right2)));
+
+        Register inside = Ops::both(Ops::less(cross1, Ops::sub(zero, bound1)),
+                                    Ops::greater(cross2, bound2));
+        Register outside = Ops::either(Ops::greater(cross1, bound1),
+                                       Ops::less(cross2, Ops::sub(zero, bound2)));
+
+        unsigned int all = (1u << Ops::LANES) - 1;
+        unsigned int insideBits = Ops::bits(inside);
+        uncertain = ~(insideBits | Ops::bits(outside)) & all;
+        return insideBits;
+    }
+#endif
+
+    // Calls onVertex(index) for every vertex that detail::isVertexInCone
+    // places inside the cone, in index order.
+    template<typename VertexHandler>
+    void forEachVertexInCone(LineSegment const & ls1,
+                             LineSegment const & ls2,
+                             Vec2 const & origin,
+                             VertexHandler const & onVertex) const
+    {
+        unsigned int numVertices = getNumberEdges();
+        unsigned int i = 0;
+
+#if defined(CXD_SIMD_AVX) || defined(CXD_SIMD_SSE2)
+        Vec2 direction1 = ls1.direction();
+        Vec2 direction2 = ls2.direction();
+
+        for(; i + Ops::LANES <= numVertices; i += Ops::LANES)
+        {
+            unsigned int uncertain;
+            unsigned int inside = coneMask(origin, direction1, direction2, i, uncertain);
+
+            for(unsigned int lane=0; (inside | uncertain) != 0; ++lane, inside >>= 1, uncertain >>= 1)
+            {
+                if((inside & 1) != 0 ||
+                   ((uncertain & 1) != 0 && detail::isVertexInCone(ls1, ls2, origin, Vec2{xs[i+lane], ys[i+lane]})))
+                    onVertex((int)(i + lane));
+            }
+        }
+#endif
+
+        for(; i<numVertices; ++i)
+        {
+            if(detail::isVertexInCone(ls1, ls2, origin, Vec2{xs[i], ys[i]}))
+                onVertex((int)i);
+        }
+    }
+
+    // Calls onHit(edgeIndex, position) for every edge the segment crosses,
+    // in index order, until onHit returns false.
+    template<typename HitHandler>
+    void forEachIntersection(LineSegment const & segment,
+                             HitHandler const & onHit) const
+    {
+        unsigned int numEdges = getNumberEdges();
+        unsigned int i = 0;
+
+#if defined(CXD_SIMD_AVX) || defined(CXD_SIMD_SSE2)
+        for(; i + Ops::LANES <= numEdges; i += Ops::LANES)
+        {
+            CXD_STATS_ADD(edgeIntersectionTests, Ops::LANES);
+
+            unsigned int mask = candidateMask(segment, i);
+            for(unsigned int lane=0; mask != 0; ++lane, mask >>= 1)
+            {
+                if((mask & 1) != 0 && reportHit(segment, i + lane, onHit) == false)
+                    return;
+            }
+        }
+#endif
+
+        for(; i<numEdges; ++i)
+        {
+            CXD_STATS_ADD(edgeIntersectionTests, 1);
+
+            if(reportHit(segment, i, onHit) == false)
+                return;
+        }
+    }
+};
+
+// Fixed capacity, stack resident buffer that keeps the Capacity hits
+// closest to an origin while hits are streamed in. Ties go to the lower
+// edge index, so the result does not depend on the order hits arrive in.
+template<typename Scalar, int Capacity>
+class SliceHitBuffer
+{
+    typedef BasicVec2<Scalar> Vec2;
+    typedef BasicSliceVertex<Scalar> SliceVertex;
+
+    SliceVertex hits[Capacity];
+    int numHits;
+    Vec2 origin;
+
+    static bool isCloser(SliceVertex const & v1, SliceVertex const & v2)
+    {
+        if(v1.distanceToSlice != v2.distanceToSlice)
+            return v1.distanceToSlice < v2.distanceToSlice;
+
+        return v1.index < v2.index;
+    }
+
+public:
+    explicit SliceHitBuffer(Vec2 const & _origin) : numHits{0}, origin{_origin} {}
+
+    void add(int index, Vec2 const & position)
+    {
+        SliceVertex hit(position);
+        hit.index = index;
+        hit.distanceToSlice = Vec2::square(position - origin);
+
+        if(numHits == Capacity && isCloser(hit, hits[Capacity-1]) == false)
+            return;
+
+        int i = numHits < Capacity ? numHits++ : Capacity-1;
+        for(; i > 0 && isCloser(hit, hits[i-1]); --i)
+            hits[i] = hits[i-1];
+        hits[i] = hit;
+    }
+
+    void sortByIndex()
+    {
+        for(int i=1; i<numHits; ++i)
+            for(int j=i; j > 0 && hits[j].index < hits[j-1].index; --j)
+                std::swap(hits[j], hits[j-1]);
+    }
+
+    int size() const
+    {
+        return numHits;
+    }
+
+    SliceVertex const & operator [] (int i) const
+    {
+        return hits[i];
+    }
+
+    // Returns the hit on the given edge, or nullptr if there is none
+    SliceVertex const * findEdge(int index) const
+    {
+        for(int i=0; i<numHits; ++i)
+            if(hits[i].index == index)
+                return &hits[i];
+
+        return nullptr;
+    }
+};
+
+struct PieceRange
+{
+    unsigned int first;
+    unsigned int count;
+};
+
+// Flat decomposition result: every convex piece is a range into one
+// shared vertex buffer, in the same order as returnLowestLevelPolys.
+template<typename Scalar>
+struct BasicConvexDecomposition
+{
+    typedef BasicVec2<Scalar> Vec2;
+    typedef BasicVertex<Scalar> Vertex;
+    typedef BasicVertexSpan<Scalar> VertexSpan;
+
+    std::vector<Vertex > vertices;
+    std::vector<PieceRange > pieces;
+
+    void clear()
+    {
+        vertices.clear();
+        pieces.clear();
+    }
+
+    void addPiece(VertexSpan const & pieceVertices)
+    {
+        PieceRange range = {(unsigned int)vertices.size(),
+                            (unsigned int)pieceVertices.size()};
+        vertices.insert(vertices.end(), pieceVertices.begin(), pieceVertices.end());
+        pieces.push_back(range);
+    }
+
+    int getNumberPieces() const
+    {
+        return pieces.size();
+    }
+
+    VertexSpan getPiece(int pieceIndex) const
+    {
+        PieceRange const & range = pieces[pieceIndex];
+        return VertexSpan(vertices.data() + range.first, range.count);
+    }
+
+    // Hertel-Mehlhorn style pass: every edge two pieces share exactly is a
+    // cut, and cuts are removed greedily in one pass, longest first, when
+    // both of their end vertices stay convex. Returns the number of pieces
+    // merged away. A merged piece takes the place of its first part and the
+    // other pieces keep their order and vertices. Pieces that are not
+    // anticlockwise are left alone.
+    int mergePieces()
+    {
+        return mergeLabelledPieces(nullptr);
+    }
+
+    // As above, keeping edgeLabels[i], a value per edge starting at
+    // vertices[i], attached to its edge.
+    int mergePieces(std::vector<int > & edgeLabels)
+    {
+        return mergeLabelledPieces(&edgeLabels);
+    }
+
+private:
+    int mergeLabelledPieces(std::vector<int > * edgeLabels)
+    {
+        if(pieces.size() < 2)
+            return 0;
+
+        struct EdgeKey
+        {
+            Vec2 lower;
+            Vec2 upper;
+            unsigned int slot;
+        };
+
+        struct SharedEdge
+        {
+            unsigned int slot;
+            unsigned int twin;
+            Scalar lengthSquared;
+        };
+
+        unsigned int numVertices = vertices.size();
+        unsigned int numPieces = pieces.size();
+
+        // Every piece is a circular list over its vertex slots. A merge
+        // relinks two lists and retires the slots on the removed cut;
+        // alias then points at the live slot that starts the same edge.
+        std::vector<unsigned int > next(numVertices);
+        std::vector<unsigned int > prev(numVertices);
+        std::vector<unsigned int > alias(numVertices);
+        std::vector<unsigned int > slotPiece(numVertices);
+        std::vector<unsigned int > group(numPieces);
+        std::vector<EdgeKey > keys;
+        keys.reserve(numVertices);
+
+        for(unsigned int i=0; i<numPieces; ++i)
+        {
+            PieceRange const & range = pieces[i];
+            group[i] = i;
+
+            Scalar twiceArea = 0.0f;
+            for(unsigned int k=0; k<range.count; ++k)
+            {
+                unsigned int slot = range.first + k;
+                unsigned int nextSlot = range.first + (k+1 < range.count ? k+1 : 0);
+                next[slot] = nextSlot;
+                prev[nextSlot] = slot;
+                alias[slot] = slot;
+                slotPiece[slot] = i;
+
+                twiceArea += Vec2::cross(vertices[slot].position - vertices[range.first].position,
+                                         vertices[nextSlot].position - vertices[range.first].position);
+            }
+
+            if(range.count < 3 || twiceArea <= 0.0f)
+                continue;
+
+            for(unsigned int k=0; k<range.count; ++k)
+            {
+                unsigned int slot = range.first + k;
+                Vec2 start = vertices[slot].position;
+                Vec2 end = vertices[next[slot]].position;
+                if(isBefore(end, start))
+                    keys.push_back({end, start, slot});
+                else
+                    keys.push_back({start, end, slot});
+            }
+        }
+
+        auto isSameEdge = [](EdgeKey const & a, EdgeKey const & b)
+        {
+            return isSamePosition(a.lower, b.lower) && isSamePosition(a.upper, b.upper);
+        };
+
+        std::sort(keys.begin(), keys.end(), [](EdgeKey const & a, EdgeKey const & b)
+        {
+            if(isBefore(a.lower, b.lower) || isBefore(b.lower, a.lower))
+                return isBefore(a.lower, b.lower);
+            if(isBefore(a.upper, b.upper) || isBefore(b.upper, a.upper))
+                return isBefore(a.upper, b.upper);
+            return a.slot < b.slot;
+        });
+
+        // Only edges found exactly twice, once in each direction, are cuts
+        std::vector<SharedEdge > cuts;
+        for(unsigned int i=0; i+1<keys.size(); ++i)
+        {
+            if(isSameEdge(keys[i], keys[i+1]) == false)
+                continue;
+
+            bool unique = (i == 0 || isSameEdge(keys[i-1], keys[i]) == false) &&
+                          (i+2 == keys.size() || isSameEdge(keys[i+1], keys[i+2]) == false);
+            unsigned int slot = keys[i].slot;
+            unsigned int twin = keys[i+1].slot;
+
+            if(unique && slotPiece[slot] != slotPiece[twin] &&
+               isSamePosition(vertices[slot].position, vertices[next[twin]].position))
+            {
+                Vec2 edge = keys[i].upper - keys[i].lower;
+                cuts.push_back({slot, twin, Vec2::square(edge)});
+            }
+            ++i;
+        }
+
+        std::stable_sort(cuts.begin(), cuts.end(), [](SharedEdge const & a, SharedEdge const & b)
+        {
+            return a.lengthSquared > b.lengthSquared;
+        });
+
+        auto resolve = [&alias](unsigned int slot)
+        {
+            while(alias[slot] != slot)
+                slot = alias[slot];
+            return slot;
+        };
+
+        auto findGroup = [&group](unsigned int piece)
+        {
+            while(group[piece] != piece)
+            {
+                group[piece] = group[group[piece]];
+                piece = group[piece];
+            }
+            return piece;
+        };
+
+        auto position = [this](unsigned int slot) -> Vec2 const &
+        {
+            return vertices[slot].position;
+        };
+
+        int merged = 0;
+
+        // One pass, longest cut first. Removing a cut adds up the angles at
+        // its ends, which only makes other cuts ending there harder to
+        // remove. The exception is a straight run of cuts through a
+        // crossing, which could go as a whole once the pieces on one side
+        // are merged; its parts are not tried again, so it stays split.
+        for(unsigned int i=0; i<cuts.size(); ++i)
+        {
+            // The cut runs a -> b in the first piece and b -> a in the other
+            unsigned int aFirst = resolve(cuts[i].slot);
+            unsigned int bOther = resolve(cuts[i].twin);
+            unsigned int bFirst = next[aFirst];
+            unsigned int aOther = next[bOther];
+
+            if(isSamePosition(position(bFirst), position(bOther)) == false ||
+               isSamePosition(position(aOther), position(aFirst)) == false)
+                continue;
+
+            unsigned int firstGroup = findGroup(slotPiece[aFirst]);
+            unsigned int otherGroup = findGroup(slotPiece[bOther]);
+            if(firstGroup == otherGroup)
+                continue;
+
+            // A cut split by later cuts ending on it is several shared
+            // edges in a row, which have to go together
+            while(next[bFirst] != aFirst &&
+                  isSamePosition(position(next[bFirst]), position(prev[bOther])))
+            {
+                bFirst = next[bFirst];
+                bOther = prev[bOther];
+            }
+            while(prev[aFirst] != bFirst &&
+                  isSamePosition(position(prev[aFirst]), position(next[aOther])))
+            {
+                aFirst = prev[aFirst];
+                aOther = next[aOther];
+            }
+
+            unsigned int afterA = next[aOther];
+            unsigned int beforeB = prev[bOther];
+
+            if(isConvexTurn(position(prev[aFirst]), position(aFirst), position(afterA)) == false ||
+               isConvexTurn(position(beforeB), position(bFirst), position(next[bFirst])) == false)
+                continue;
+
+            // Every retired slot on the cut starts an edge that no longer
+            // exists, apart from aOther, whose edge now starts at aFirst
+            for(unsigned int slot=next[aFirst]; slot!=bFirst; slot=next[slot])
+                alias[slot] = aFirst;
+            for(unsigned int slot=bOther; slot!=afterA; slot=next[slot])
+                alias[slot] = aFirst;
+
+            next[aFirst] = afterA;
+            prev[afterA] = aFirst;
+            next[beforeB] = bFirst;
+            prev[bFirst] = beforeB;
+            if(edgeLabels != nullptr)
+                (*edgeLabels)[aFirst] = (*edgeLabels)[aOther];
+
+            group[std::max(firstGroup, otherGroup)] = std::min(firstGroup, otherGroup);
+            ++merged;
+        }
+
+        CXD_STATS_ADD(piecesMerged, merged);
+
+        if(merged == 0)
+            return 0;
+
+        std::vector<Vertex > mergedVertices;
+        std::vector<PieceRange > mergedPieces;
+        std::vector<int > mergedLabels;
+        mergedVertices.reserve(numVertices);
+        mergedPieces.reserve(numPieces - merged);
+        if(edgeLabels != nullptr)
+            mergedLabels.reserve(numVertices);
+
+        for(unsigned int i=0; i<numPieces; ++i)
+        {
+            if(findGroup(i) != i)
+                continue;
+
+            PieceRange range = {(unsigned int)mergedVertices.size(), 0};
+
+            if(pieces[i].count < 3)
+            {
+                mergedVertices.insert(mergedVertices.end(),
+                                      vertices.begin() + pieces[i].first,
+                                      vertices.begin() + pieces[i].first + pieces[i].count);
+                if(edgeLabels != nullptr)
+                    mergedLabels.insert(mergedLabels.end(),
+                                        edgeLabels->begin() + pieces[i].first,
+                                        edgeLabels->begin() + pieces[i].first + pieces[i].count);
+            }
+            else
+            {
+                unsigned int start = resolve(pieces[i].first);
+                unsigned int slot = start;
+                do
+                {
+                    mergedVertices.push_back(vertices[slot]);
+                    if(edgeLabels != nullptr)
+                        mergedLabels.push_back((*edgeLabels)[slot]);
+                    slot = next[slot];
+                }
+                while(slot != start);
+            }
+
+            range.count = mergedVertices.size() - range.first;
+            mergedPieces.push_back(range);
+        }
+
+        vertices.swap(mergedVertices);
+        pieces.swap(mergedPieces);
+        if(edgeLabels != nullptr)
+            edgeLabels->swap(mergedLabels);
+
+        return merged;
+    }
+
+    static bool isSamePosition(Vec2 const & a, Vec2 const & b)
+    {
+        return a.x == b.x && a.y == b.y;
+    }
+
+    static bool isBefore(Vec2 const & a, Vec2 const & b)
+    {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    }
+
+    // A left turn at corner, or straight on. Turning back on the same
+    // line would leave a zero width slit.
+    static bool isConvexTurn(Vec2 const & before, Vec2 const & corner, Vec2 const & after)
+    {
+        int sign = detail::crossSign(before, corner, corner, after);
+        if(sign != 0)
+            return sign > 0;
+
+        return Vec2::dot(corner - before, after - corner) > 0.0f;
+    }
+};
+
+typedef BasicConvexDecomposition<double> ConvexDecomposition;
+typedef BasicConvexDecomposition<float> ConvexDecompositionf;
+
+// Adjacency of the pieces of a flat decomposition in compressed sparse row
+// form, e.g. for a navigation mesh. The neighbours of piece i are
+// neighbours[offsets[i]] up to neighbours[offsets[i+1]], sorted, and
+// portals[k] is the stretch of cut that piece i shares with neighbours[k],
+// running anticlockwise around piece i. The polygon's own outline never
+// forms a portal, nor do pieces that only touch at a vertex.
+template<typename Scalar>
+struct BasicPieceGraph
+{
+    typedef BasicLineSegment<Scalar> LineSegment;
+
+    std::vector<unsigned int > offsets;
+    std::vector<unsigned int > neighbours;
+    std::vector<LineSegment > portals;
+
+    void clear()
+    {
+        offsets.clear();
+        neighbours.clear();
+        portals.clear();
+    }
+
+    int getNumberPieces() const
+    {
+        return offsets.size() > 0 ? offsets.size() - 1 : 0;
+    }
+
+    Span<unsigned int const> getNeighbours(int pieceIndex) const
+    {
+        return Span<unsigned int const>(neighbours.data() + offsets[pieceIndex],
+                                        offsets[pieceIndex+1] - offsets[pieceIndex]);
+    }
+
+    Span<LineSegment const> getPortals(int pieceIndex) const
+    {
+        return Span<LineSegment const>(portals.data() + offsets[pieceIndex],
+                                       offsets[pieceIndex+1] - offsets[pieceIndex]);
+    }
+};
+
+typedef BasicPieceGraph<double> PieceGraph;
+typedef BasicPieceGraph<float> PieceGraphf;
+
+// What a collision engine needs about one convex piece, padded to a cache
+// line. range selects the piece's vertices and edge normals in the
+// arrays of its BasicPhysicsDecomposition.
+template<typename Scalar>
+struct alignas(64) BasicPieceProperties
+{
+    BasicBoundingBox<Scalar> bounds;
+    BasicVec2<Scalar> centroid;
+    Scalar area;
+    PieceRange range;
+};
+
+// Flat decomposition result for physics engines. Vertices and outward
+// unit edge normals are kept as separate x and y arrays, so SAT and GJK
+// loops can stream them, and the properties of each piece are computed
+// in the same pass that stores its vertices.
+template<typename Scalar>
+struct BasicPhysicsDecomposition
+{
+    typedef BasicVec2<Scalar> Vec2;
+    typedef BasicVertexSpan<Scalar> VertexSpan;
+    typedef BasicPieceProperties<Scalar> PieceProperties;
+
+    std::vector<PieceProperties > pieces;
+
+    // Normal i belongs to the edge from vertex i to vertex i+1
+    std::vector<Scalar > xs;
+    std::vector<Scalar > ys;
+    std::vector<Scalar > normalXs;
+    std::vector<Scalar > normalYs;
+
+    void clear()
+    {
+        pieces.clear();
+        xs.clear();
+        ys.clear();
+        normalXs.clear();
+        normalYs.clear();
+    }
+
+    void addPiece(VertexSpan const & pieceVertices)
+    {
+        unsigned int numVertices = pieceVertices.size();
+
+        PieceProperties properties;
+        properties.range = {(unsigned int)xs.size(), numVertices};
+        properties.centroid = {0.0f, 0.0f};
+        properties.area = 0.0f;
+
+        if(numVertices == 0)
+        {
+            pieces.push_back(properties);
+            return;
+        }
+
+        // Area and centroid are summed relative to the first vertex, which
+        // keeps them accurate far from the origin
+        Vec2 origin = pieceVertices[0].position;
+        Scalar twiceArea = 0.0f;
+        Vec2 weightedSum = {0.0f, 0.0f};
+
+        for(unsigned int i=0; i<numVertices; ++i)
+        {
+            Vec2 position = pieceVertices[i].position;
+            Vec2 nextPosition = pieceVertices[i+1 < numVertices ? i+1 : 0].position;
+
+            xs.push_back(position.x);
+            ys.push_back(position.y);
+            properties.bounds.expand(position);
+
+            Vec2 edge = nextPosition - position;
+            Scalar length = std::sqrt(edge.x*edge.x + edge.y*edge.y);
+            Scalar inverseLength = length > 0.0f ? 1.0f / length : 0.0f;
+            normalXs.push_back(edge.y * inverseLength);
+            normalYs.push_back(-edge.x * inverseLength);
+
+            Vec2 relative = position - origin;
+            Vec2 nextRelative = nextPosition - origin;
+            Scalar cross = Vec2::cross(relative, nextRelative);
+            twiceArea += cross;
+            weightedSum = weightedSum + (relative + nextRelative) * cross;
+        }
+
+        // Pieces come out anticlockwise, for which the normals above point
+        // outwards; degenerate input may still give a clockwise piece
+        if(twiceArea < 0.0f)
+        {
+            for(unsigned int i=properties.range.first; i<xs.size(); ++i)
+            {
+                normalXs[i] = -normalXs[i];
+                normalYs[i] = -normalYs[i];
+            }
+        }
+
+        properties.area = std::abs(twiceArea) * 0.5f;
+
+        if(twiceArea != 0.0f)
+            properties.centroid = origin + weightedSum / (3.0f * twiceArea);
+        else
+        {
+            properties.centroid = (properties.bounds.lower + properties.bounds.upper) * 0.5f;
+        }
+
+        pieces.push_back(properties);
+    }
+
+    int getNumberPieces() const
+    {
+        return pieces.size();
+    }
+
+    PieceProperties const & getPiece(int pieceIndex) const
+    {
+        return pieces[pieceIndex];
+    }
+};
+
+typedef BasicPieceProperties<double> PieceProperties;
+typedef BasicPieceProperties<float> PiecePropertiesf;
+typedef BasicPhysicsDecomposition<double> PhysicsDecomposition;
+typedef BasicPhysicsDecomposition<float> PhysicsDecompositionf;
+
+// Finds the piece of a flat decomposition that contains a point, or the
+// pieces a segment overlaps, through a bounding volume hierarchy over the
+// boxes of the pieces. Each edge is kept as a half-plane whose limit is
+// loosened by the rounding error of the test, so a point on a cut lies in
+// both pieces that share it and findPiece reports the lower index. The
+// half-planes of a piece are padded to whole vector registers so a single
+// point tests several edges per instruction; findPieces instead carries
+// one point per lane down the hierarchy. Both give the same answers.
+template<typename Scalar>
+class BasicPieceLocator
+{
+    typedef BasicVec2<Scalar> Vec2;
+    typedef BasicLineSegment<Scalar> LineSegment;
+    typedef BasicBoundingBox<Scalar> BoundingBox;
+
+#if defined(CXD_SIMD_AVX) || defined(CXD_SIMD_SSE2)
+    typedef detail::SimdOps<Scalar> Ops;
+    typedef typename Ops::Register Register;
+    static const unsigned int LANES = Ops::LANES;
+#else
+    static const unsigned int LANES = 1;
+#endif
+
+    static const unsigned int LEAF_SIZE = 4;
+
+    // Nodes are split at the median, so the hierarchy of any piece count
+    // that fits an unsigned int is at most 33 levels deep
+    static const int STACK_SIZE = 64;
+
+    // Interior nodes have a count of 0 and their children at first and
+    // first+1; leaves hold slots first to first+count-1
+    struct Node
+    {
+        BoundingBox bounds;
+        unsigned int first;
+        unsigned int count;
+    };
+
+    std::vector<Node > nodes;
+
+    // Pieces in the order the leaves refer to them
+    std::vector<int > slotPieces;
+    std::vector<BoundingBox > slotBounds;
+    std::vector<PieceRange > slotEdges;
+
+    // A point is inside edge i when normalXs[i]*x + normalYs[i]*y >= limits[i]
+    std::vector<Scalar > normalXs;
+    std::vector<Scalar > normalYs;
+    std::vector<Scalar > limits;
+
+    static bool contains(BoundingBox const & box, Vec2 const & point)
+    {
+        return point.x >= box.lower.x && point.x <= box.upper.x &&
+               point.y >= box.lower.y && point.y <= box.upper.y;
+    }
+
+    bool isInside(unsigned int slot, Vec2 const & point) const
+    {
+        PieceRange edges = slotEdges[slot];
+        unsigned int i = edges.first;
+        unsigned int end = edges.first + edges.count;
+
+#if defined(CXD_SIMD_AVX) || defined(CXD_SIMD_SSE2)
+        Register x = Ops::set(point.x);
+        Register y = Ops::set(point.y);
+
+        for(; i<end; i+=LANES)
+        {
+            Register value = evaluate(Ops::load(&normalXs[i]), x, Ops::load(&normalYs[i]), y);
+            if(Ops::bits(Ops::less(value, Ops::load(&limits[i]))) != 0)
+                return false;
+        }
+#else
+        for(; i<end; ++i)
+        {
+            if(detail::mulAdd(normalXs[i], point.x, normalYs[i] * point.y) < limits[i])
+                return false;
+        }
+#endif
+
+        return true;
+    }
+
+#if defined(CXD_SIMD_AVX) || defined(CXD_SIMD_SSE2)
+    // Fused exactly where detail::mulAdd is
+    static Register evaluate(Register normalX, Register x, Register normalY, Register y)
+    {
+#ifdef __FMA__
+        return Ops::fusedMulAdd(normalX, x, Ops::mul(normalY, y));
+#else
+        return Ops::add(Ops::mul(normalX, x), Ops::mul(normalY, y));
+#endif
+    }
+
+    static unsigned int containsMask(BoundingBox const & box, Register x, Register y)
+    {
+        Register inX = Ops::both(Ops::greaterEqual(x, Ops::set(box.lower.x)),
+                                 Ops::greaterEqual(Ops::set(box.upper.x), x));
+        Register inY = Ops::both(Ops::greaterEqual(y, Ops::set(box.lower.y)),
+                                 Ops::greaterEqual(Ops::set(box.upper.y), y));
+        return Ops::bits(Ops::both(inX, inY));
+    }
+
+    // Lanes of mask whose point is inside the piece in slot
+    unsigned int insideMask(unsigned int slot, Register x, Register y, unsigned int mask) const
+    {
+        PieceRange edges = slotEdges[slot];
+        unsigned int end = edges.first + edges.count;
+
+        for(unsigned int i=edges.first; i<end && mask != 0; ++i)
+        {
+            Register value = evaluate(Ops::set(normalXs[i]), x, Ops::set(normalYs[i]), y);
+            mask &= ~Ops::bits(Ops::less(value, Ops::set(limits[i])));
+        }
+
+        return mask;
+    }
+
+    void findPacket(Vec2 const * points, int * pieces) const
+    {
+        Scalar pointXs[LANES];
+        Scalar pointYs[LANES];
+        for(unsigned int lane=0; lane<LANES; ++lane)
+        {
+            pointXs[lane] = points[lane].x;
+            pointYs[lane] = points[lane].y;
+            pieces[lane] = -1;
+        }
+
+        Register x = Ops::load(pointXs);
+        Register y = Ops::load(pointYs);
+
+        unsigned int stack[STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while(stackSize > 0)
+        {
+            Node const & node = nodes[stack[--stackSize]];
+
+            unsigned int mask = containsMask(node.bounds, x, y);
+            if(mask == 0)
+                continue;
+
+            if(node.count == 0)
+            {
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+                continue;
+            }
+
+            for(unsigned int slot=node.first; slot<node.first+node.count; ++slot)
+            {
+                int piece = slotPieces[slot];
+                unsigned int inside = insideMask(slot, x, y, mask & containsMask(slotBounds[slot], x, y));
+
+                for(unsigned int lane=0; inside != 0; ++lane, inside >>= 1)
+                {
+                    if((inside & 1) != 0 && (pieces[lane] < 0 || piece < pieces[lane]))
+                        pieces[lane] = piece;
+                }
+            }
+        }
+    }
+#endif
+
+    // Clips the segment against each half-plane of the piece in slot
+    bool overlaps(unsigned int slot, LineSegment const & segment) const
+    {
+        PieceRange edges = slotEdges[slot];
+        Scalar lowerT = 0.0f;
+        Scalar upperT = 1.0f;
+
+        for(unsigned int i=edges.first; i<edges.first+edges.count; ++i)
+        {
+            Scalar startValue = detail::mulAdd(normalXs[i], segment.startPos.x, normalYs[i] * segment.startPos.y) - limits[i];
+            Scalar finalValue = detail::mulAdd(normalXs[i], segment.finalPos.x, normalYs[i] * segment.finalPos.y) - limits[i];
+
+            if(startValue < 0.0f && finalValue < 0.0f)
+                return false;
+            if(startValue < 0.0f)
+                lowerT = std::max(lowerT, startValue / (startValue - finalValue));
+            else if(finalValue < 0.0f)
+                upperT = std::min(upperT, startValue / (startValue - finalValue));
+
+            if(lowerT > upperT)
+                return false;
+        }
+
+        return true;
+    }
+
+public:
+    BasicPieceLocator() {}
+
+    explicit BasicPieceLocator(BasicConvexDecomposition<Scalar> const & decomposition)
+    {
+        build(decomposition);
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        slotPieces.clear();
+        slotBounds.clear();
+        slotEdges.clear();
+        normalXs.clear();
+        normalYs.clear();
+        limits.clear();
+    }
+
+    void build(BasicConvexDecomposition<Scalar> const & decomposition)
+    {
+        const Scalar PRODUCT = detail::ErrorBounds<Scalar>::PRODUCT;
+
+        clear();
+
+        unsigned int numPieces = decomposition.getNumberPieces();
+        if(numPieces == 0)
+            return;
+
+        std::vector<BoundingBox > pieceBounds(numPieces);
+        std::vector<Vec2 > centres(numPieces);
+
+        for(unsigned int i=0; i<numPieces; ++i)
+        {
+            BasicVertexSpan<Scalar> piece = decomposition.getPiece(i);
+            BoundingBox & box = pieceBounds[i];
+
+            for(unsigned int j=0; j<piece.size(); ++j)
+                box.expand(piece[j].position);
+
+            if(piece.size() == 0)
+            {
+                centres[i] = {0.0f, 0.0f};
+                continue;
+            }
+
+            // Covers every point the loosened half-planes accept
+            Scalar magnitude = std::max(std::max(std::abs(box.lower.x), std::abs(box.upper.x)),
+                                        std::max(std::abs(box.lower.y), std::abs(box.upper.y)));
+            Scalar margin = 8.0f * PRODUCT * magnitude;
+            box.lower = box.lower - Vec2{margin, margin};
+            box.upper = box.upper + Vec2{margin, margin};
+            centres[i] = (box.lower + box.upper) * 0.5f;
+        }
+
+        // Built top down, splitting the pieces at the median centre along
+        // the wider axis of their centres
+        struct Task
+        {
+            unsigned int node;
+            unsigned int begin;
+            unsigned int end;
+        };
+
+        slotPieces.resize(numPieces);
+        for(unsigned int i=0; i<numPieces; ++i)
+            slotPieces[i] = i;
+
+        nodes.push_back(Node());
+        std::vector<Task > tasks;
+        tasks.push_back({0, 0, numPieces});
+
+        while(tasks.empty() == false)
+        {
+            Task task = tasks.back();
+            tasks.pop_back();
+
+            BoundingBox bounds;
+            BoundingBox centreBounds;
+            for(unsigned int i=task.begin; i<task.end; ++i)
+            {
+                bounds.expand(pieceBounds[slotPieces[i]]);
+                centreBounds.expand(centres[slotPieces[i]]);
+            }
+
+            nodes[task.node].bounds = bounds;
+
+            if(task.end - task.begin <= LEAF_SIZE)
+            {
+                nodes[task.node].first = task.begin;
+                nodes[task.node].count = task.end - task.begin;
+                continue;
+            }
+
+            bool splitX = centreBounds.upper.x - centreBounds.lower.x >=
+                          centreBounds.upper.y - centreBounds.lower.y;
+            unsigned int middle = task.begin + (task.end - task.begin) / 2;
+
+            std::nth_element(slotPieces.begin() + task.begin, slotPieces.begin() + middle,
+                             slotPieces.begin() + task.end, [&centres, splitX](int a, int b)
+            {
+                return splitX ? centres[a].x < centres[b].x : centres[a].y < centres[b].y;
+            });
+
+            unsigned int children = nodes.size();
+            nodes.resize(children + 2);
+            nodes[task.node].first = children;
+            nodes[task.node].count = 0;
+
+            tasks.push_back({children, task.begin, middle});
+            tasks.push_back({children + 1, middle, task.end});
+        }
+
+        // Half-planes are stored in slot order, so a leaf reads one run
+        for(unsigned int slot=0; slot<numPieces; ++slot)
+        {
+            BasicVertexSpan<Scalar> piece = decomposition.getPiece(slotPieces[slot]);
+            unsigned int numVertices = piece.size();
+
+            Scalar twiceArea = 0.0f;
+            for(unsigned int i=0; i<numVertices; ++i)
+            {
+                Vec2 relative = piece[i].position - piece[0].position;
+                Vec2 nextRelative = piece[(i+1) % numVertices].position - piece[0].position;
+                twiceArea += Vec2::cross(relative, nextRelative);
+            }
+
+            // Pieces come out anticlockwise; degenerate input may still
+            // give a clockwise one
+            Scalar orientation = twiceArea < 0.0f ? -1.0f : 1.0f;
+
+            PieceRange edges = {(unsigned int)limits.size(),
+                                (numVertices + LANES - 1) / LANES * LANES};
+
+            for(unsigned int i=0; i<edges.count; ++i)
+            {
+                // Padding repeats the first edge
+                unsigned int j = i < numVertices ? i : 0;
+                Vec2 position = piece[j].position;
+                Vec2 edge = piece[(j+1) % numVertices].position - position;
+
+                Scalar normalX = -edge.y * orientation;
+                Scalar normalY = edge.x * orientation;
+                Scalar limit = detail::mulAdd(normalX, position.x, normalY * position.y);
+                Scalar slack = 4.0f * PRODUCT * (std::abs(normalX * position.x) + std::abs(normalY * position.y));
+
+                normalXs.push_back(normalX);
+                normalYs.push_back(normalY);
+                limits.push_back(limit - slack);
+            }
+
+            slotBounds.push_back(pieceBounds[slotPieces[slot]]);
+            slotEdges.push_back(edges);
+        }
+    }
+
+    int getNumberPieces() const
+    {
+        return slotPieces.size();
+    }
+
+    // Index of the lowest numbered piece containing the point, or -1
+    int findPiece(Vec2 const & point) const
+    {
+        int found = -1;
+
+        if(nodes.empty())
+            return found;
+
+        unsigned int stack[STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while(stackSize > 0)
+        {
+            Node const & node = nodes[stack[--stackSize]];
+
+            if(contains(node.bounds, point) == false)
+                continue;
+
+            if(node.count == 0)
+            {
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+                continue;
+            }
+
+            for(unsigned int slot=node.first; slot<node.first+node.count; ++slot)
+            {
+                int piece = slotPieces[slot];
+
+                if((found < 0 || piece < found) &&
+                   contains(slotBounds[slot], point) && isInside(slot, point))
+                    found = piece;
+            }
+        }
+
+        return found;
+    }
+
+    // pieces[i] = findPiece(points[i]) for every point; pieces must be at
+    // least as long as points
+    void findPieces(Span<Vec2 const> points, Span<int> pieces) const
+    {
+        std::size_t i = 0;
+
+#if defined(CXD_SIMD_AVX) || defined(CXD_SIMD_SSE2)
+        if(nodes.empty() == false)
+        {
+            for(; i + LANES <= points.size(); i += LANES)
+                findPacket(points.data() + i, pieces.data() + i);
+        }
+#endif
+
+        for(; i<points.size(); ++i)
+            pieces[i] = findPiece(points[i]);
+    }
+
+    // Replaces pieces with the indices of every piece the segment
+    // overlaps, including pieces it only touches, in increasing order
+    void findOverlappingPieces(LineSegment const & segment, std::vector<int > & pieces) const
+    {
+        pieces.clear();
+
+        if(nodes.empty())
+            return;
+
+        unsigned int stack[STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+
+        while(stackSize > 0)
+        {
+            Node const & node = nodes[stack[--stackSize]];
+
+            if(node.bounds.mayIntersect(segment) == false)
+                continue;
+
+            if(node.count == 0)
+            {
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = node.first + 1;
+                continue;
+            }
+
+            for(unsigned int slot=node.first; slot<node.first+node.count; ++slot)
+            {
+                if(slotBounds[slot].mayIntersect(segment) && overlaps(slot, segment))
+                    pieces.push_back(slotPieces[slot]);
+            }
+        }
+
+        std::sort(pieces.begin(), pieces.end());
+    }
+};
+
+typedef BasicPieceLocator<double> PieceLocator;
+typedef BasicPieceLocator<float> PieceLocatorf;
+
+// Every array a polygon owns, and the temporaries its decomposition and
+// slicing use, come from Allocator rebound to the element type. Sub
+// polygons inherit their parent's allocator, so a stateful allocator such
+// as std::pmr::polymorphic_allocator covers the whole tree.
+template<typename Scalar, typename Allocator = std::allocator<BasicVertex<Scalar> > >
+class BasicConcavePolygon
+{
+    typedef BasicVec2<Scalar> Vec2;
+    typedef BasicVertex<Scalar> Vertex;
+    typedef BasicSliceVertex<Scalar> SliceVertex;
+    typedef BasicLineSegment<Scalar> LineSegment;
+    typedef BasicVertexSpan<Scalar> VertexSpan;
+    typedef BasicConvexDecomposition<Scalar> ConvexDecomposition;
+    typedef BasicPieceGraph<Scalar> PieceGraph;
+    typedef BasicPhysicsDecomposition<Scalar> PhysicsDecomposition;
+    typedef BasicBoundingBox<Scalar> BoundingBox;
+
+    template<typename T>
+    using Array = std::vector<T, typename std::allocator_traits<Allocator>::template rebind_alloc<T> >;
+
+    typedef Array<Vertex > VertexArray;
+    typedef Array<BasicConcavePolygon > PolygonArray;
+    typedef Array<int > IntArray;
+    typedef EdgeCoordinates<Scalar, typename std::allocator_traits<Allocator>::template rebind_alloc<Scalar> > Edges;
+
+    VertexArray vertices;
+    IntArray reflexVertices;
+    PolygonArray subPolygons;
+
+    // Covers the edges of this node and of every node below it; pieces
+    // are folded in as they are attached
+    BoundingBox bounds;
+
+    // The segment this node was sliced along, once it has sub polygons;
+    // zero length otherwise
+    LineSegment cut{Vec2{}, Vec2{}};
+
+    struct NodeOnly {};
+
+    // Copies one node without its sub polygons, which the copy
+    // constructor then fills in
+    BasicConcavePolygon(BasicConcavePolygon const & other, NodeOnly) :
+        vertices(other.vertices), reflexVertices(other.reflexVertices),
+        subPolygons(std::allocator_traits<typename PolygonArray::allocator_type>::
+                    select_on_container_copy_construction(other.subPolygons.get_allocator())),
+        bounds(other.bounds), cut(other.cut) {}
+
+    static int mod(int x, int m)
+    {
+        int r = x%m;
+        return r<0 ? r+m : r;
+    }
+
+    static void flipPolygon(Span<Vertex > _verts)
+    {
+        int iMax = _verts.size()/2;
+
+        if(_verts.size() % 2 != 0)
+            iMax += 1;
+
+        for(int i=1; i<iMax; ++i)
+        {
+            std::swap(_verts[i], _verts[_verts.size()-i]);
+        }
+    }
+
+    static bool checkIfRightHanded(VertexSpan _verts)
+    {
+        if(_verts.size() < 3)
+            return false;
+
+        Scalar signedArea = 0.0f;
+
+        for(unsigned int i=0; i<_verts.size(); ++i)
+        {
+            signedArea += Vec2::getSignedArea(_verts[i].position,
+                                                   _verts[mod(i+1, _verts.size())].position);
+        }
+
+        if(signedArea < 0.0f)
+            return true;
+
+        return false;
+    }
+
+
+
+    static bool isVertexInCone(LineSegment const & ls1,
+                        LineSegment const & ls2,
+                        Vec2 const & origin,
+                        Vertex const & vert)
+    {
+        return detail::isVertexInCone(ls1, ls2, origin, vert.position);
+    }
+
+    static void findVerticesInCone(LineSegment const & ls1,
+                                   LineSegment const & ls2,
+                                   Vec2 const & origin,
+                                   Edges const & edges,
+                                   IntArray & result)
+    {
+        result.clear();
+
+        edges.forEachVertexInCone(ls1, ls2, origin, [&](int i)
+        {
+            result.push_back(i);
+        });
+    }
+
+    static bool checkVisibility(Vec2 const & originalPosition,
+                                Vertex const & vert,
+                                Edges const & edges)
+    {
+        CXD_STATS_ADD(visibilityTests, 1);
+
+        const int MAX_INTERSECTIONS = 3;
+
+        LineSegment ls(originalPosition, vert.position);
+        int numIntersections = 0;
+
+        edges.forEachIntersection(ls, [&](int, Vec2 const &)
+        {
+            return ++numIntersections <= MAX_INTERSECTIONS;
+        });
+
+        if(numIntersections > MAX_INTERSECTIONS)
+            return false;
+
+        return true;
+    }
+
+
+    struct ConnectCandidate
+    {
+        int tier;
+        Scalar distance;
+        int index;
+    };
+
+    // Candidates are scored in one pass. Tier 0 are reflex vertices whose
+    // own cone contains the origin, tier 1 the other reflex vertices; the
+    // first visible one in tier order wins. If none is visible, or the
+    // budget runs out, the closest candidate of any kind is used.
+    static int getBestVertexToConnect(IntArray const & indices,
+                                      VertexSpan polygonVertices,
+                                      Vec2 const & origin,
+                                      Edges const & edges,
+                                      DecompOptions const & options)
+    {
+        if(indices.size()==1)
+        {
+            if(checkVisibility(origin, polygonVertices[indices[0]], edges))
+                return indices[0];
+        }
+        else if(indices.size() > 1)
+        {
+            Array<ConnectCandidate > candidates(indices.get_allocator());
+            candidates.reserve(indices.size());
+
+            Scalar minDistance = 1e+15;
+            int closest = indices[0];
+            int vertSize = polygonVertices.size();
+
+            for(unsigned int i=0; i<indices.size(); ++i)
+            {
+                int index = indices[i];
+                Scalar currDistance = Vec2::square(polygonVertices[index].position - origin);
+                if(currDistance < minDistance)
+                {
+                    minDistance = currDistance;
+                    closest = index;
+                }
+
+                Vertex prevVert = polygonVertices[mod(index-1, vertSize)].position;
+                Vertex currVert = polygonVertices[index].position;
+                Vertex nextVert = polygonVertices[mod(index+1, vertSize)].position;
+
+                if(Vertex::getOrientation(prevVert, currVert, nextVert) >= 0)
+                    continue;
+
+                LineSegment ls1(prevVert.position, currVert.position);
+                LineSegment ls2(nextVert.position, currVert.position);
+
+                int tier = isVertexInCone(ls1, ls2, currVert.position, Vertex(origin)) ? 0 : 1;
+                candidates.push_back({tier, currDistance, index});
+            }
+
+            bool bounded = options.cutSearch == CutSearch::Bounded;
+
+            // Nearer candidates have shorter sight lines, which cross fewer
+            // edges and tend to be rejected sooner
+            std::sort(candidates.begin(), candidates.end(),
+                      [bounded](ConnectCandidate const & a, ConnectCandidate const & b)
+            {
+                if(a.tier != b.tier)
+                    return a.tier < b.tier;
+                if(bounded && a.distance != b.distance)
+                    return a.distance < b.distance;
+                return a.index < b.index;
+            });
+
+            unsigned int numTests = candidates.size();
+            if(bounded && numTests > options.maxVisibilityTests)
+                numTests = options.maxVisibilityTests;
+
+            for(unsigned int i=0; i<numTests; ++i)
+            {
+                if(checkVisibility(origin, polygonVertices[candidates[i].index], edges))
+                    return candidates[i].index;
+            }
+
+            return closest;
+        }
+
+
+        return -1;
+    }
+
+    static LineSegment findDecompositionCut(VertexSpan _vertices,
+                                            int reflexIndex,
+                                            Edges const & edges,
+                                            DecompOptions const & options,
+                                            Allocator const & allocator)
+    {
+        CXD_STATS_PHASE(cutSearchSeconds);
+
+        Vec2 prevVertPos = _vertices[mod(reflexIndex-1, _vertices.size())].position;
+        Vec2 currVertPos = _vertices[reflexIndex].position;
+        Vec2 nextVertPos = _vertices[mod(reflexIndex+1, _vertices.size())].position;
+
+        LineSegment ls1(prevVertPos, currVertPos);
+        LineSegment ls2(nextVertPos, currVertPos);
+
+        IntArray vertsInCone(allocator);
+        findVerticesInCone(ls1, ls2, currVertPos, edges, vertsInCone);
+
+        if(vertsInCone.size() > 0)
+        {
+            int bestVert = getBestVertexToConnect(vertsInCone, _vertices, currVertPos, edges, options);
+            if(bestVert != -1)
+                return LineSegment(currVertPos, _vertices[bestVert].position);
+        }
+
+        return LineSegment(currVertPos, (ls1.direction() + ls2.direction()) * 1e+10);
+    }
+
+    static bool isReflexVertex(VertexSpan _vertices, int index)
+    {
+        int orientation = Vertex::getOrientation(_vertices[mod(index-1, _vertices.size())],
+                                                 _vertices[index],
+                                                 _vertices[mod(index+1, _vertices.size())]);
+        return orientation < 0;
+    }
+
+    // Each simplification step below compacts _vertices in place and
+    // leaves them untouched if fewer than three vertices would remain.
+    static void weldVertices(VertexArray & _vertices, Scalar weldDistance)
+    {
+        Scalar weldSquared = weldDistance * weldDistance;
+        unsigned int kept = 0;
+
+        for(unsigned int i=0; i<_vertices.size(); ++i)
+        {
+            if(kept == 0 ||
+               Vec2::square(_vertices[i].position - _vertices[kept-1].position) > weldSquared)
+                _vertices[kept++] = _vertices[i];
+        }
+
+        while(kept > 1 &&
+              Vec2::square(_vertices[kept-1].position - _vertices[0].position) <= weldSquared)
+            --kept;
+
+        if(kept >= 3)
+            _vertices.resize(kept);
+    }
+
+    // True if middle lies between its neighbours, within distance of the
+    // line through them
+    static bool isCollinear(Vec2 const & previous,
+                            Vec2 const & middle,
+                            Vec2 const & next,
+                            Scalar distance)
+    {
+        Vec2 span = next - previous;
+        if(Vec2::dot(middle - previous, span) < 0.0f ||
+           Vec2::dot(middle - next, span) > 0.0f)
+            return false;
+
+        if(distance == 0.0f)
+            return detail::crossSign(previous, next, previous, middle) == 0;
+
+        return std::abs(Vec2::cross(span, middle - previous)) <= distance * Vec2::length(span);
+    }
+
+    static void removeCollinearVertices(VertexArray & _vertices, Scalar distance)
+    {
+        VertexArray kept(_vertices.get_allocator());
+        kept.reserve(_vertices.size());
+
+        for(unsigned int i=0; i<_vertices.size(); ++i)
+        {
+            while(kept.size() >= 2 &&
+                  isCollinear(kept[kept.size()-2].position, kept.back().position,
+                              _vertices[i].position, distance))
+                kept.pop_back();
+
+            kept.push_back(_vertices[i]);
+        }
+
+        // Runs can wrap around the first vertex
+        unsigned int first = 0;
+        bool removed = true;
+        while(removed && kept.size() - first > 3)
+        {
+            removed = false;
+            if(isCollinear(kept[kept.size()-2].position, kept.back().position,
+                           kept[first].position, distance))
+            {
+                kept.pop_back();
+                removed = true;
+            }
+            else if(isCollinear(kept.back().position, kept[first].position,
+                                kept[first+1].position, distance))
+            {
+                ++first;
+                removed = true;
+            }
+        }
+
+        if(kept.size() - first >= 3)
+            _vertices.assign(kept.begin() + first, kept.end());
+    }
+
+    static Scalar squaredDistanceToSegment(Vec2 const & point,
+                                           Vec2 const & startPos,
+                                           Vec2 const & finalPos)
+    {
+        Vec2 span = finalPos - startPos;
+        Vec2 relative = point - startPos;
+        Scalar lengthSquared = Vec2::square(span);
+
+        Scalar t = lengthSquared > 0.0f ? Vec2::dot(relative, span) / lengthSquared : 0.0f;
+        t = std::max(Scalar(0), std::min(Scalar(1), t));
+
+        return Vec2::square(relative - span * t);
+    }
+
+    // Douglas-Peucker on the closed outline, split at vertex 0 and the
+    // vertex farthest from it. Ranges wait on an explicit stack.
+    static void simplifyOutline(VertexArray & _vertices, Scalar maxError)
+    {
+        unsigned int numVertices = _vertices.size();
+        if(numVertices <= 3)
+            return;
+
+        unsigned int farthest = 0;
+        Scalar farthestDistance = 0.0f;
+        for(unsigned int i=1; i<numVertices; ++i)
+        {
+            Scalar distance = Vec2::square(_vertices[i].position - _vertices[0].position);
+            if(distance > farthestDistance)
+            {
+                farthest = i;
+                farthestDistance = distance;
+            }
+        }
+
+        if(farthest == 0)
+            return;
+
+        Array<bool > keep(numVertices, false, _vertices.get_allocator());
+        keep[0] = true;
+        keep[farthest] = true;
+
+        // Index numVertices stands for vertex 0 at the end of the outline
+        Array<PieceRange > pending(_vertices.get_allocator());
+        pending.push_back({0, farthest});
+        pending.push_back({farthest, numVertices - farthest});
+
+        Scalar maxSquared = maxError * maxError;
+        unsigned int numKept = 2;
+
+        while(pending.size() > 0)
+        {
+            PieceRange range = pending.back();
+            pending.pop_back();
+
+            unsigned int last = range.first + range.count;
+            Vec2 startPos = _vertices[range.first].position;
+            Vec2 finalPos = _vertices[last % numVertices].position;
+
+            unsigned int worst = 0;
+            Scalar worstDistance = maxSquared;
+            for(unsigned int i=range.first+1; i<last; ++i)
+            {
+                Scalar distance = squaredDistanceToSegment(_vertices[i].position, startPos, finalPos);
+                if(distance > worstDistance)
+                {
+                    worst = i;
+                    worstDistance = distance;
+                }
+            }
+
+            if(worst == 0)
+                continue;
+
+            keep[worst] = true;
+            ++numKept;
+            pending.push_back({range.first, worst - range.first});
+            pending.push_back({worst, last - worst});
+        }
+
+        if(numKept < 3)
+            return;
+
+        unsigned int kept = 0;
+        for(unsigned int i=0; i<numVertices; ++i)
+        {
+            if(keep[i])
+                _vertices[kept++] = _vertices[i];
+        }
+        _vertices.resize(kept);
+    }
+
+    static void findReflexVertices(VertexSpan _vertices, IntArray & result)
+    {
+        result.clear();
+
+        for(unsigned int i=0; i<_vertices.size(); ++i)
+        {
+            if(isReflexVertex(_vertices, i))
+                result.push_back(i);
+        }
+    }
+
+    // A sliced piece keeps the neighbours of every vertex it shares with
+    // its parent, except next to the cut. So only the cut endpoints and
+    // their neighbours are re-tested; everything else keeps its status.
+    static void inheritReflexVertices(Span<int const> parentReflex,
+                                      VertexSpan pieceVerts,
+                                      IntArray const & pieceOrigins,
+                                      IntArray & pieceReflex)
+    {
+        pieceReflex.clear();
+
+        int numVerts = pieceVerts.size();
+        unsigned int cursor = 0;
+
+        for(int i=0; i<numVerts; ++i)
+        {
+            int origin = pieceOrigins[i];
+
+            if(origin < 0 ||
+               pieceOrigins[mod(i-1, numVerts)] < 0 ||
+               pieceOrigins[mod(i+1, numVerts)] < 0)
+            {
+                if(isReflexVertex(pieceVerts, i))
+                    pieceReflex.push_back(i);
+                continue;
+            }
+
+            while(cursor < parentReflex.size() && parentReflex[cursor] < origin)
+                ++cursor;
+
+            if(cursor < parentReflex.size() && parentReflex[cursor] == origin)
+                pieceReflex.push_back(i);
+        }
+    }
+
+    // Orients a freshly sliced piece and works out its reflex vertices,
+    // falling back to a full scan only when the piece had to be flipped.
+    // Returns true if it was flipped.
+    static bool prepareSlicedPiece(Span<int const> parentReflex,
+                                   IntArray const & pieceOrigins,
+                                   VertexArray & pieceVerts,
+                                   IntArray & pieceReflex)
+    {
+        if(pieceVerts.size() > 2 && checkIfRightHanded(pieceVerts) == false)
+        {
+            flipPolygon(pieceVerts);
+            findReflexVertices(pieceVerts, pieceReflex);
+            return true;
+        }
+
+        inheritReflexVertices(parentReflex, pieceVerts, pieceOrigins, pieceReflex);
+        return false;
+    }
+
+    // Gives every edge of a sliced piece the label of the parent edge it
+    // runs along, or cutLabel. An edge runs along parent edge e if it
+    // starts at vertex e or at the intersection point on e, and ends at
+    // vertex e+1 or at an intersection point that replaced it. Edge i runs
+    // from piece vertex i to i+1, in the order before any flip.
+    static void labelSlicedEdges(VertexSpan parentVerts,
+                                 Span<int const> parentLabels,
+                                 LineSegment const & cut,
+                                 IntArray const & pieceOrigins,
+                                 int cutLabel,
+                                 bool flipped,
+                                 IntArray & pieceLabels)
+    {
+        int numVertices = pieceOrigins.size();
+        int numParentVertices = parentVerts.size();
+        pieceLabels.resize(numVertices);
+
+        for(int i=0; i<numVertices; ++i)
+        {
+            int origin = pieceOrigins[i];
+            int nextOrigin = pieceOrigins[mod(i+1, numVertices)];
+            int parentEdge = origin < 0 ? -1 - origin : origin;
+            int nextParentVertex = mod(parentEdge + 1, numParentVertices);
+
+            bool alongParent;
+            if(nextOrigin >= 0)
+                alongParent = nextOrigin == nextParentVertex;
+            else if(-1 - nextOrigin == parentEdge)
+                alongParent = origin >= 0;
+            else if(-1 - nextOrigin == nextParentVertex)
+            {
+                // splitAlongSegment drops a vertex within SLICE_TOLERANCE
+                // of the cut when the edge after it is hit
+                Vec2 relative = parentVerts[nextParentVertex].position - cut.startPos;
+                alongParent = std::abs(Vec2::cross(relative, cut.direction())) <=
+                              ScalarTraits<Scalar>::SLICE_TOLERANCE;
+            }
+            else
+                alongParent = false;
+
+            pieceLabels[i] = alongParent ? parentLabels[parentEdge] : cutLabel;
+        }
+
+        // flipPolygon keeps vertex 0 and reverses the rest, which turns
+        // edge i into the reverse of edge n-1-i
+        if(flipped)
+            std::reverse(pieceLabels.begin(), pieceLabels.end());
+    }
+
+    static int selectReflexVertex(VertexSpan _vertices,
+                                  Span<int const> reflex,
+                                  ReflexOrder order)
+    {
+        CXD_STATS_PHASE(reflexSearchSeconds);
+
+        if(order == ReflexOrder::First)
+            return reflex[0];
+
+        int selected = reflex[0];
+        double smallestTurn = 0.0;
+
+        for(unsigned int i=0; i<reflex.size(); ++i)
+        {
+            int index = reflex[i];
+            Vec2 edge1 = _vertices[index].position - _vertices[mod(index-1, _vertices.size())].position;
+            Vec2 edge2 = _vertices[mod(index+1, _vertices.size())].position - _vertices[index].position;
+
+            double turn = std::atan2(Vec2::cross(edge1, edge2), Vec2::dot(edge1, edge2));
+            if(i == 0 || turn < smallestTurn)
+            {
+                smallestTurn = turn;
+                selected = index;
+            }
+        }
+
+        return selected;
+    }
+
+    // A cut from a reflex vertex into its cone normally leaves each side
+    // with fewer reflex vertices, but not always: the fallback ray is so
+    // long that INTERSECTION_TOLERANCE on its parameter can accept a hit
+    // behind the reflex vertex. Slicing the same region again would then
+    // never terminate, so the piece is kept whole and stays non-convex.
+    static bool isSliceProgressing(std::size_t parentReflex,
+                                   std::size_t leftReflex,
+                                   std::size_t rightReflex)
+    {
+        return leftReflex < parentReflex && rightReflex < parentReflex;
+    }
+
+    void flipPolygon()
+    {
+        flipPolygon(vertices);
+    }
+
+    // Splits the vertices into the pieces either side of the segment. The
+    // origin arrays record where every piece vertex came from: its index in
+    // _vertices, or -1-e for an intersection point on edge e.
+    static bool splitAlongSegment(LineSegment const & segment,
+                                  VertexSpan _vertices,
+                                  Edges const & edges,
+                                  VertexArray & leftVerts,
+                                  VertexArray & rightVerts,
+                                  IntArray & leftOrigins,
+                                  IntArray & rightOrigins)
+    {
+        CXD_STATS_PHASE(sliceSeconds);
+
+        const Scalar TOLERANCE = ScalarTraits<Scalar>::SLICE_TOLERANCE;
+
+        SliceHitBuffer<Scalar, 2> slicedVertices(segment.startPos);
+
+        edges.forEachIntersection(segment, [&](int index, Vec2 const & position)
+        {
+            slicedVertices.add(index, position);
+            return true;
+        });
+
+        if(slicedVertices.size() < 2)
+            return false;
+
+        slicedVertices.sortByIndex();
+
+        leftVerts.clear();
+        rightVerts.clear();
+        leftOrigins.clear();
+        rightOrigins.clear();
+
+        for(int i=0; i<(int)_vertices.size(); ++i)
+        {
+            Vec2 relativePosition = _vertices[i].position - segment.startPos;
+
+            SliceVertex const * slicedVertex = slicedVertices.findEdge(i);
+
+            Scalar perpDistance = std::abs(Vec2::cross(relativePosition, segment.direction()));
+
+            if( perpDistance > TOLERANCE ||
+              ( perpDistance <= TOLERANCE && slicedVertex == nullptr )
+            )
+            {
+                //std::cout << relCrossProd << ", i: " << i << "\n";
+                if((i > slicedVertices[0].index) && (i <= slicedVertices[1].index))
+                {
+                    leftVerts.push_back(_vertices[i]);
+                    leftOrigins.push_back(i);
+                    //std::cout << i << " leftVertAdded\n";
+                }
+                else
+                {
+                    rightVerts.push_back(_vertices[i]);
+                    rightOrigins.push_back(i);
+                    //std::cout << i << " rightVertAdded\n";
+                }
+
+            }
+
+            if(slicedVertex != nullptr)
+            {
+                rightVerts.push_back(Vertex(slicedVertex->position));
+                leftVerts.push_back(Vertex(slicedVertex->position));
+                rightOrigins.push_back(-1 - i);
+                leftOrigins.push_back(-1 - i);
+            }
+        }
+
+        CXD_STATS_ADD(slicesPerformed, 1);
+        CXD_STATS_ADD(verticesCopied, leftVerts.size() + rightVerts.size());
+
+        return true;
+    }
+
+    template<typename Result>
+    void appendLowestLevelPolys(Result & result) const
+    {
+        forEachLeaf([&](VertexSpan leafVertices)
+        {
+            result.addPiece(leafVertices);
+        });
+    }
+
+    BasicConcavePolygon(VertexArray && _vertices,
+                   IntArray && _reflexVertices) : vertices{std::move(_vertices)},
+                   reflexVertices{std::move(_reflexVertices)},
+                   subPolygons(vertices.get_allocator()),
+                   bounds{BoundingBox::aroundEdges(vertices)} {}
+
+    // Appends the candidates whose segment may reach the box to cuts and
+    // returns where they were put.
+    static PieceRange appendReachingCuts(BoundingBox const & box,
+                                         Span<LineSegment const> segments,
+                                         IntArray const & candidates,
+                                         IntArray & cuts)
+    {
+        PieceRange range = {(unsigned int)cuts.size(), 0};
+
+        for(unsigned int i=0; i<candidates.size(); ++i)
+        {
+            if(box.mayIntersect(segments[candidates[i]]))
+                cuts.push_back(candidates[i]);
+            else
+                CXD_STATS_ADD(subtreesCulled, 1);
+        }
+
+        range.count = cuts.size() - range.first;
+        return range;
+    }
+
+    void attachSubPolygons(BasicConcavePolygon && left, BasicConcavePolygon && right)
+    {
+        bounds.expand(left.bounds);
+        bounds.expand(right.bounds);
+        subPolygons.push_back(std::move(left));
+        subPolygons.push_back(std::move(right));
+    }
+
+    // Slices this leaf along the segment and attaches the two pieces, which
+    // inherit this polygon's reflex set. Returns false if nothing was cut.
+    bool sliceLeaf(LineSegment const & segment,
+                   Edges const & edges,
+                   bool requireProgress)
+    {
+        Allocator allocator = getAllocator();
+        VertexArray leftVerts(allocator);
+        VertexArray rightVerts(allocator);
+        IntArray leftOrigins(allocator);
+        IntArray rightOrigins(allocator);
+
+        if(splitAlongSegment(segment, vertices, edges,
+                             leftVerts, rightVerts, leftOrigins, rightOrigins) == false)
+            return false;
+
+        IntArray leftReflex(allocator);
+        IntArray rightReflex(allocator);
+
+        {
+            CXD_STATS_PHASE(reflexSearchSeconds);
+            prepareSlicedPiece(reflexVertices, leftOrigins, leftVerts, leftReflex);
+            prepareSlicedPiece(reflexVertices, rightOrigins, rightVerts, rightReflex);
+        }
+
+        if(requireProgress &&
+           isSliceProgressing(reflexVertices.size(), leftReflex.size(), rightReflex.size()) == false)
+            return false;
+
+        // The piece arrays are local to this call, so the children take
+        // them over instead of copying
+        attachSubPolygons(BasicConcavePolygon(std::move(leftVerts), std::move(leftReflex)),
+                          BasicConcavePolygon(std::move(rightVerts), std::move(rightReflex)));
+        cut = segment;
+        return true;
+    }
+
+    void releaseVertices()
+    {
+        VertexArray(vertices.get_allocator()).swap(vertices);
+        IntArray(reflexVertices.get_allocator()).swap(reflexVertices);
+    }
+
+    // Which line every edge of a flat result lies on, for its PieceGraph:
+    // edges[i] indexes lines for the edge starting at result vertex i. The
+    // polygon's own edges come first, then one line per cut.
+    struct EdgeLabels
+    {
+        std::vector<int > edges;
+        std::vector<LineSegment > lines;
+    };
+
+    // Decomposes this polygon's vertices straight into a flat result
+    // without building sub-polygon nodes. Pending pieces live on a
+    // single work buffer used as a stack, so no per-piece allocation
+    // happens once the buffers have grown. Result needs clear() and
+    // addPiece(VertexSpan), which is called while the finished piece is
+    // still in cache unless the pieces are merged or a graph is built.
+    template<typename Result>
+    void decomposeInto(Result & result, PieceGraph * graph, DecompOptions const & options) const
+    {
+        CXD_STATS_SCOPE();
+
+        if(options.mergePieces == false && graph == nullptr)
+        {
+            decomposePieces(result, nullptr, options);
+            return;
+        }
+
+        ConvexDecomposition pieces;
+        decomposeFlat(pieces, graph, options);
+
+        result.clear();
+        for(int i=0; i<pieces.getNumberPieces(); ++i)
+            result.addPiece(pieces.getPiece(i));
+    }
+
+    void decomposeInto(ConvexDecomposition & result, PieceGraph * graph, DecompOptions const & options) const
+    {
+        CXD_STATS_SCOPE();
+
+        decomposeFlat(result, graph, options);
+    }
+
+    void decomposeFlat(ConvexDecomposition & result, PieceGraph * graph, DecompOptions const & options) const
+    {
+        if(graph == nullptr)
         {
-            tempSegment.startPos = _vertices[i].position;
-            tempSegment.finalPos = _vertices[mod(i+1, _vertices.size())].position;
+            decomposePieces(result, nullptr, options);
+            if(options.mergePieces)
+                result.mergePieces();
+            return;
+        }
+
+        EdgeLabels labels;
+        decomposePieces(result, &labels, options);
+        if(options.mergePieces)
+            result.mergePieces(labels.edges);
+
+        buildPieceGraph(result, labels, *graph);
+    }
+
+    // Pairs up the pieces either side of every line by where their edges
+    // on it overlap, so no piece is compared with another. Edges on the
+    // outline have no partner, unless a tolerant intersection made two
+    // pieces run back along the same polygon edge.
+    static void buildPieceGraph(ConvexDecomposition const & decomposition,
+                                EdgeLabels const & labels,
+                                PieceGraph & graph)
+    {
+        struct CutEdge
+        {
+            int cut;
+            bool forward;
+            Scalar lower;
+            Scalar upper;
+            Vec2 lowerPosition;
+            Vec2 upperPosition;
+            unsigned int piece;
+        };
+
+        struct Link
+        {
+            unsigned int piece;
+            unsigned int neighbour;
+            LineSegment portal;
+        };
+
+        std::vector<CutEdge > cutEdges;
+
+        for(int i=0; i<decomposition.getNumberPieces(); ++i)
+        {
+            PieceRange const & range = decomposition.pieces[i];
+
+            for(unsigned int k=0; k<range.count; ++k)
+            {
+                int cut = labels.edges[range.first + k];
+                LineSegment const & cutSegment = labels.lines[cut];
+                Vec2 start = decomposition.vertices[range.first + k].position;
+                Vec2 end = decomposition.vertices[range.first + (k+1 < range.count ? k+1 : 0)].position;
+                Scalar startAlong = Vec2::dot(start - cutSegment.startPos, cutSegment.direction());
+                Scalar endAlong = Vec2::dot(end - cutSegment.startPos, cutSegment.direction());
+
+                if(startAlong < endAlong)
+                    cutEdges.push_back({cut, true, startAlong, endAlong, start, end, (unsigned int)i});
+                else if(endAlong < startAlong)
+                    cutEdges.push_back({cut, false, endAlong, startAlong, end, start, (unsigned int)i});
+            }
+        }
+
+        std::sort(cutEdges.begin(), cutEdges.end(), [](CutEdge const & a, CutEdge const & b)
+        {
+            if(a.cut != b.cut)
+                return a.cut < b.cut;
+            if(a.forward != b.forward)
+                return a.forward;
+            return a.lower < b.lower;
+        });
+
+        std::vector<Link > links;
+
+        for(unsigned int first=0; first<cutEdges.size(); )
+        {
+            unsigned int middle = first;
+            while(middle < cutEdges.size() && cutEdges[middle].cut == cutEdges[first].cut &&
+                  cutEdges[middle].forward)
+                ++middle;
+            unsigned int last = middle;
+            while(last < cutEdges.size() && cutEdges[last].cut == cutEdges[first].cut)
+                ++last;
+
+            // Both sides are sorted along the cut, so one sweep finds
+            // every overlapping pair
+            unsigned int i = first;
+            unsigned int j = middle;
+            while(i < middle && j < last)
+            {
+                CutEdge const & forward = cutEdges[i];
+                CutEdge const & backward = cutEdges[j];
+
+                Vec2 lowerPosition = forward.lower > backward.lower ? forward.lowerPosition : backward.lowerPosition;
+                Vec2 upperPosition = forward.upper < backward.upper ? forward.upperPosition : backward.upperPosition;
+
+                if(std::max(forward.lower, backward.lower) < std::min(forward.upper, backward.upper) &&
+                   forward.piece != backward.piece)
+                {
+                    links.push_back({forward.piece, backward.piece, LineSegment(lowerPosition, upperPosition)});
+                    links.push_back({backward.piece, forward.piece, LineSegment(upperPosition, lowerPosition)});
+                }
+
+                if(forward.upper < backward.upper)
+                    ++i;
+                else
+                    ++j;
+            }
+
+            first = last;
+        }
+
+        std::stable_sort(links.begin(), links.end(), [](Link const & a, Link const & b)
+        {
+            if(a.piece != b.piece)
+                return a.piece < b.piece;
+            return a.neighbour < b.neighbour;
+        });
+
+        graph.clear();
+        graph.offsets.assign(decomposition.getNumberPieces() + 1, 0);
+        graph.neighbours.reserve(links.size());
+        graph.portals.reserve(links.size());
+
+        for(unsigned int i=0; i<links.size(); ++i)
+        {
+            ++graph.offsets[links[i].piece + 1];
+            graph.neighbours.push_back(links[i].neighbour);
+            graph.portals.push_back(links[i].portal);
+        }
+
+        for(unsigned int i=1; i<graph.offsets.size(); ++i)
+            graph.offsets[i] += graph.offsets[i-1];
+    }
 
-            std::pair<bool, Vec2 > intersectionResult = LineSegment::intersects(segment, tempSegment);
+    template<typename Result>
+    void decomposePieces(Result & result, EdgeLabels * labels, DecompOptions const & options) const
+    {
+        result.clear();
 
-            if(intersectionResult.first == true)
+        // Vertices and reflex indices of pending pieces share one stack
+        // discipline, so both buffers shrink back as pieces are finished.
+        struct PendingPiece
+        {
+            PieceRange verts;
+            PieceRange reflex;
+        };
+
+        Allocator allocator = getAllocator();
+        VertexArray workVerts(vertices, allocator);
+        IntArray workReflex(reflexVertices, allocator);
+        Array<PendingPiece > pending(allocator);
+        VertexArray leftVerts(allocator);
+        VertexArray rightVerts(allocator);
+        IntArray leftOrigins(allocator);
+        IntArray rightOrigins(allocator);
+        IntArray leftReflex(allocator);
+        IntArray rightReflex(allocator);
+        Edges edges(allocator);
+
+        // Edge labels follow the vertices, so they share their ranges
+        IntArray workLabels(allocator);
+        IntArray leftLabels(allocator);
+        IntArray rightLabels(allocator);
+        if(labels != nullptr)
+        {
+            labels->edges.clear();
+            labels->lines.clear();
+            workLabels.resize(vertices.size());
+            for(unsigned int i=0; i<vertices.size(); ++i)
             {
-                result.insert({i, Vertex(intersectionResult.second)});
+                workLabels[i] = i;
+                labels->lines.push_back(LineSegment(vertices[i].position,
+                                                    vertices[mod(i+1, vertices.size())].position));
             }
         }
 
-        return result;
+        pending.push_back({{0, (unsigned int)workVerts.size()},
+                           {0, (unsigned int)workReflex.size()}});
+
+        while(pending.size() > 0)
+        {
+            PendingPiece piece = pending.back();
+            pending.pop_back();
+
+            VertexSpan pieceVerts(workVerts.data() + piece.verts.first, piece.verts.count);
+            Span<int const> pieceReflex(workReflex.data() + piece.reflex.first, piece.reflex.count);
+
+            bool sliced = false;
+            bool leftFlipped = false;
+            bool rightFlipped = false;
+            LineSegment cut;
+
+            if(pieceVerts.size() > 3 && pieceReflex.size() > 0)
+            {
+                edges.assign(pieceVerts);
+
+                int reflexIndex = selectReflexVertex(pieceVerts, pieceReflex, options.reflexOrder);
+                CXD_STATS_ADD(reflexVerticesFound, 1);
+
+                cut = findDecompositionCut(pieceVerts, reflexIndex, edges, options, allocator);
+
+                sliced = splitAlongSegment(cut, pieceVerts, edges,
+                                           leftVerts, rightVerts, leftOrigins, rightOrigins);
+            }
+
+            if(sliced)
+            {
+                CXD_STATS_PHASE(reflexSearchSeconds);
+                leftFlipped = prepareSlicedPiece(pieceReflex, leftOrigins, leftVerts, leftReflex);
+                rightFlipped = prepareSlicedPiece(pieceReflex, rightOrigins, rightVerts, rightReflex);
+                sliced = isSliceProgressing(pieceReflex.size(), leftReflex.size(), rightReflex.size());
+            }
+
+            if(sliced == false)
+            {
+                result.addPiece(pieceVerts);
+                if(labels != nullptr)
+                {
+                    labels->edges.insert(labels->edges.end(),
+                                         workLabels.begin() + piece.verts.first,
+                                         workLabels.begin() + piece.verts.first + piece.verts.count);
+                    workLabels.resize(piece.verts.first);
+                }
+                workVerts.resize(piece.verts.first);
+                workReflex.resize(piece.reflex.first);
+                continue;
+            }
+
+            if(labels != nullptr)
+            {
+                Span<int const> pieceLabels(workLabels.data() + piece.verts.first, piece.verts.count);
+                int cutLabel = labels->lines.size();
+                labels->lines.push_back(cut);
+                labelSlicedEdges(pieceVerts, pieceLabels, cut, leftOrigins, cutLabel, leftFlipped, leftLabels);
+                labelSlicedEdges(pieceVerts, pieceLabels, cut, rightOrigins, cutLabel, rightFlipped, rightLabels);
+
+                workLabels.resize(piece.verts.first);
+                workLabels.insert(workLabels.end(), rightLabels.begin(), rightLabels.end());
+                workLabels.insert(workLabels.end(), leftLabels.begin(), leftLabels.end());
+            }
+
+            workVerts.resize(piece.verts.first);
+            workReflex.resize(piece.reflex.first);
+
+            PendingPiece rightPiece = {{(unsigned int)workVerts.size(), (unsigned int)rightVerts.size()},
+                                       {(unsigned int)workReflex.size(), (unsigned int)rightReflex.size()}};
+            workVerts.insert(workVerts.end(), rightVerts.begin(), rightVerts.end());
+            workReflex.insert(workReflex.end(), rightReflex.begin(), rightReflex.end());
+
+            PendingPiece leftPiece = {{(unsigned int)workVerts.size(), (unsigned int)leftVerts.size()},
+                                      {(unsigned int)workReflex.size(), (unsigned int)leftReflex.size()}};
+            workVerts.insert(workVerts.end(), leftVerts.begin(), leftVerts.end());
+            workReflex.insert(workReflex.end(), leftReflex.begin(), leftReflex.end());
+
+            pending.push_back(rightPiece);
+            pending.push_back(leftPiece);
+        }
     }
 
 public:
-    ConcavePolygon(VertexArray const & _vertices) : vertices{_vertices}
+    BasicConcavePolygon(VertexArray _vertices) : vertices{std::move(_vertices)},
+        reflexVertices(vertices.get_allocator()), subPolygons(vertices.get_allocator())
     {
         if(vertices.size() > 2)
             if(checkIfRightHanded() == false)
                 flipPolygon();
+
+        findReflexVertices(vertices, reflexVertices);
+        bounds = BoundingBox::aroundEdges(vertices);
+    }
+    BasicConcavePolygon(VertexSpan _vertices, Allocator const & allocator = Allocator()) :
+        BasicConcavePolygon(VertexArray(_vertices.begin(), _vertices.end(), allocator)) {}
+
+    BasicConcavePolygon() {}
+
+    explicit BasicConcavePolygon(Allocator const & allocator) : vertices(allocator),
+        reflexVertices(allocator), subPolygons(allocator) {}
+
+    // Copies the tree with an explicit stack, as the destructor tears it
+    // down, so copying a deep slice tree does not recurse either.
+    BasicConcavePolygon(BasicConcavePolygon const & other) : BasicConcavePolygon(other, NodeOnly())
+    {
+        typedef std::pair<BasicConcavePolygon *, BasicConcavePolygon const * > NodeCopy;
+
+        Array<NodeCopy > pending(1, NodeCopy(this, &other), getAllocator());
+
+        while(pending.size() > 0)
+        {
+            BasicConcavePolygon * target = pending.back().first;
+            BasicConcavePolygon const * source = pending.back().second;
+            pending.pop_back();
+
+            // Reserved up front so the children do not move while they
+            // wait on the stack
+            target->subPolygons.reserve(source->subPolygons.size());
+            for(unsigned int i=0; i<source->subPolygons.size(); ++i)
+                target->subPolygons.push_back(BasicConcavePolygon(source->subPolygons[i], NodeOnly()));
+
+            for(unsigned int i=0; i<source->subPolygons.size(); ++i)
+                pending.push_back(NodeCopy(&target->subPolygons[i], &source->subPolygons[i]));
+        }
+    }
+
+    BasicConcavePolygon(BasicConcavePolygon &&) = default;
+
+    BasicConcavePolygon & operator = (BasicConcavePolygon const & other)
+    {
+        if(this != &other)
+            *this = BasicConcavePolygon(other);
+
+        return *this;
+    }
+
+    BasicConcavePolygon & operator = (BasicConcavePolygon &&) = default;
+
+    // Children are detached onto a flat list before they are destroyed so
+    // that tearing down a deep slice tree does not recurse.
+    ~BasicConcavePolygon()
+    {
+        PolygonArray detached(std::move(subPolygons));
+
+        while(detached.size() > 0)
+        {
+            BasicConcavePolygon node(std::move(detached.back()));
+            detached.pop_back();
+
+            for(unsigned int i=0; i<node.subPolygons.size(); ++i)
+                detached.push_back(std::move(node.subPolygons[i]));
+            node.subPolygons.clear();
+        }
     }
-    ConcavePolygon() {}
 
     bool checkIfRightHanded()
     {
         return checkIfRightHanded(vertices);
     }
 
+    // Welds near duplicate vertices, drops collinear runs and optionally
+    // runs Douglas-Peucker on a polygon that has not been sliced yet, so
+    // that decomposition sees fewer vertices and no false reflex ones.
+    // Returns the number of vertices removed.
+    int simplify(SimplifyOptions const & options = SimplifyOptions())
+    {
+        if(subPolygons.size() > 0 || vertices.size() <= 3)
+            return 0;
+
+        unsigned int originalSize = vertices.size();
+
+        weldVertices(vertices, (Scalar)options.weldDistance);
+        removeCollinearVertices(vertices, (Scalar)options.collinearDistance);
+        if(options.maxError > 0.0)
+            simplifyOutline(vertices, (Scalar)options.maxError);
+
+        if(vertices.size() == originalSize)
+            return 0;
+
+        if(checkIfRightHanded() == false)
+            flipPolygon();
+
+        findReflexVertices(vertices, reflexVertices);
+        bounds = BoundingBox::aroundEdges(vertices);
+
+        return originalSize - vertices.size();
+    }
+
     void slicePolygon(int vertex1, int vertex2)
     {
+        CXD_STATS_SCOPE();
+
         if(vertex1 == vertex2 ||
            vertex2 == vertex1+1 ||
            vertex2 == vertex1-1)
@@ -467,8 +3547,8 @@ public:
         if(vertex1 > vertex2)
             std::swap(vertex1, vertex2);
 
-        VertexArray returnVerts;
-        VertexArray newVerts;
+        VertexArray returnVerts(vertices.get_allocator());
+        VertexArray newVerts(vertices.get_allocator());
         for(int i=0; i<(int)vertices.size(); ++i)
         {
             if(i==vertex1 || i==vertex2)
@@ -482,71 +3562,204 @@ public:
                 newVerts.push_back(vertices[i]);
         }
 
-        subPolygons.push_back(ConcavePolygon(returnVerts));
-        subPolygons.push_back(ConcavePolygon(newVerts));
+        CXD_STATS_ADD(slicesPerformed, 1);
+        CXD_STATS_ADD(verticesCopied, returnVerts.size() + newVerts.size());
+
+        cut = LineSegment(vertices[vertex1].position, vertices[vertex2].position);
+        attachSubPolygons(BasicConcavePolygon(std::move(returnVerts)),
+                          BasicConcavePolygon(std::move(newVerts)));
     }
 
+    // Slices every leaf the segment crosses. Subtrees whose bounds the
+    // segment misses are skipped without looking at their vertices.
     void slicePolygon(LineSegment segment)
     {
-        if(subPolygons.size() > 0)
+        sliceMany(Span<LineSegment const>(&segment, 1));
+    }
+
+    // Applies the segments in order with the same result as calling
+    // slicePolygon for each of them, but walks the tree once. Every node
+    // carries the cuts that may still reach it, so a subtree is dropped as
+    // soon as none do, and a leaf builds its edges once for all the cuts
+    // that miss it.
+    void sliceMany(Span<LineSegment const> segments)
+    {
+        CXD_STATS_SCOPE();
+
+        // A node is pushed a second time below its children so that their
+        // new pieces can be folded into its bounds once they are done. The
+        // cut lists of pending nodes share one buffer used as a stack.
+        struct PendingNode
         {
-            subPolygons[0].slicePolygon(segment);
-            subPolygons[1].slicePolygon(segment);
-            return;
-        }
+            BasicConcavePolygon * node;
+            bool childrenDone;
+            PieceRange cuts;
+        };
+
+        DecompOptions options;
+        Allocator allocator = getAllocator();
+        Array<PendingNode > pending(allocator);
+        IntArray cuts(allocator);
+        IntArray nodeCuts(allocator);
+        Edges edges(allocator);
+
+        for(unsigned int i=0; i<segments.size(); ++i)
+            nodeCuts.push_back(i);
+
+        PieceRange rootCuts = appendReachingCuts(bounds, segments, nodeCuts, cuts);
+        if(rootCuts.count > 0)
+            pending.push_back({this, false, rootCuts});
+
+        while(pending.size() > 0)
+        {
+            PendingNode current = pending.back();
+            BasicConcavePolygon * node = current.node;
+            pending.pop_back();
 
-        const float TOLERANCE = 1e-5;
+            if(current.childrenDone)
+            {
+                node->bounds.expand(node->subPolygons[0].bounds);
+                node->bounds.expand(node->subPolygons[1].bounds);
+                continue;
+            }
 
-        VertexIntMap slicedVertices = verticesAlongLineSegment(segment, vertices);
-        slicedVertices = cullByDistance(slicedVertices, segment.startPos, 2);
+            nodeCuts.assign(cuts.begin() + current.cuts.first,
+                            cuts.begin() + current.cuts.first + current.cuts.count);
+            cuts.resize(current.cuts.first);
 
-        if(slicedVertices.size() < 2)
-            return;
+            // A leaf takes its cuts in order until one slices it. The new
+            // pieces can reach further than the bounds the ancestors had
+            // when they filtered the cuts, so every later cut is offered
+            // to them again.
+            if(node->subPolygons.size() == 0)
+            {
+                edges.assign(node->vertices);
 
-        VertexArray leftVerts;
-        VertexArray rightVerts;
+                unsigned int next = 0;
+                while(next < nodeCuts.size() &&
+                      node->sliceLeaf(segments[nodeCuts[next]], edges, false) == false)
+                    ++next;
 
-        for(int i=0; i<(int)vertices.size(); ++i)
-        {
-            Vec2 relativePosition = vertices[i].position - segment.startPos;
+                if(next == nodeCuts.size())
+                    continue;
 
-            auto it = slicedVertices.begin();
+                unsigned int firstLater = nodeCuts[next] + 1;
+                nodeCuts.clear();
+                for(unsigned int i=firstLater; i<segments.size(); ++i)
+                    nodeCuts.push_back(i);
+            }
 
-            float perpDistance = std::abs(Vec2::cross(relativePosition, segment.direction()));
+            pending.push_back({node, true, {0, 0}});
 
-            if( perpDistance > TOLERANCE ||
-              ( perpDistance <= TOLERANCE && (slicedVertices.find(i)==slicedVertices.end()) )
-            )
+            for(int i=1; i>=0; --i)
             {
-                //std::cout << relCrossProd << ", i: " << i << "\n";
-                if((i > it->first) && (i <= (++it)->first))
-                {
-                    leftVerts.push_back(vertices[i]);
-                    //std::cout << i << " leftVertAdded\n";
-                }
-                else
-                {
-                    rightVerts.push_back(vertices[i]);
-                    //std::cout << i << " rightVertAdded\n";
-                }
-
+                BasicConcavePolygon * child = &node->subPolygons[i];
+                PieceRange childCuts = appendReachingCuts(child->bounds, segments, nodeCuts, cuts);
+                if(childCuts.count > 0)
+                    pending.push_back({child, false, childCuts});
             }
+        }
+    }
+
+    void sliceMany(std::vector<LineSegment > const & segments)
+    {
+        sliceMany(Span<LineSegment const>(segments));
+    }
+
+    // Performs one decomposition slice on this polygon only. Returns true
+    // if two sub polygons were created; they still need decomposing.
+    bool convexDecompStep(DecompOptions const & options = DecompOptions())
+    {
+        CXD_STATS_SCOPE();
+
+        if(subPolygons.size() > 0 || vertices.size() <= 3 || reflexVertices.size() == 0)
+            return false;
+
+        Edges edges(getAllocator());
+        edges.assign(vertices);
+
+        int reflexIndex = selectReflexVertex(vertices, reflexVertices, options.reflexOrder);
+        CXD_STATS_ADD(reflexVerticesFound, 1);
+
+        LineSegment decompositionCut = findDecompositionCut(vertices, reflexIndex, edges, options, getAllocator());
+
+        if(sliceLeaf(decompositionCut, edges, true) == false)
+            return false;
+
+        if(options.compactTree)
+            releaseVertices();
 
-            if(slicedVertices.find(i) != slicedVertices.end())
+        return true;
+    }
+
+    // Pending nodes are kept on an explicit stack rather than the call
+    // stack, so very deep slice trees cannot overflow it. A leaf for which
+    // no cut reduces its reflex vertices is left as it is, so leaves are
+    // convex in practice but not guaranteed to be.
+    void convexDecomp(DecompOptions const & options = DecompOptions())
+    {
+        CXD_STATS_SCOPE();
+
+        Array<BasicConcavePolygon * > pending(1, this, getAllocator());
+
+        while(pending.size() > 0)
+        {
+            BasicConcavePolygon * node = pending.back();
+            pending.pop_back();
+
+            if(node->convexDecompStep(options))
             {
-                rightVerts.push_back(slicedVertices[i]);
-                leftVerts.push_back(slicedVertices[i]);
+                pending.push_back(&node->subPolygons[1]);
+                pending.push_back(&node->subPolygons[0]);
             }
         }
 
-        subPolygons.push_back(ConcavePolygon(leftVerts));
-        subPolygons.push_back(ConcavePolygon(rightVerts));
+        updateBounds();
+    }
+
+    // Decomposes this polygon's vertices straight into a flat result
+    // without building sub-polygon nodes. As with the tree, a piece no cut
+    // makes progress on is output whole and may be non-convex. Physics
+    // output, mergePieces and PieceLocator assume convex pieces.
+    void convexDecomp(ConvexDecomposition & result,
+                      DecompOptions const & options = DecompOptions()) const
+    {
+        decomposeInto(result, nullptr, options);
+    }
+
+    // Decomposes into per piece bounds, area, centroid and edge normals,
+    // computed as each piece is finished rather than in a second pass.
+    void convexDecomp(PhysicsDecomposition & result,
+                      DecompOptions const & options = DecompOptions()) const
+    {
+        decomposeInto(result, nullptr, options);
+    }
+
+    // Also fills graph with the pieces that share a stretch of cut. Every
+    // slice labels the edges it creates, so no edge matching between
+    // pieces is needed.
+    void convexDecomp(ConvexDecomposition & result,
+                      PieceGraph & graph,
+                      DecompOptions const & options = DecompOptions()) const
+    {
+        decomposeInto(result, &graph, options);
+    }
+
+    void convexDecomp(PhysicsDecomposition & result,
+                      PieceGraph & graph,
+                      DecompOptions const & options = DecompOptions()) const
+    {
+        decomposeInto(result, &graph, options);
     }
 
-    void convexDecomp()
+    Allocator getAllocator() const
     {
-        if(vertices.size() > 3)
-            convexDecomp(vertices);
+        return Allocator(vertices.get_allocator());
+    }
+
+    IntArray const & getReflexVertices() const
+    {
+        return reflexVertices;
     }
 
     VertexArray const & getVertices() const
@@ -554,7 +3767,15 @@ public:
         return vertices;
     }
 
-    ConcavePolygon const & getSubPolygon(int subPolyIndex) const
+    BasicConcavePolygon const & getSubPolygon(int subPolyIndex) const
+    {
+        if(subPolygons.size() > 0 && subPolyIndex < (int)subPolygons.size())
+            return subPolygons[subPolyIndex];
+
+        return *this;
+    }
+
+    BasicConcavePolygon & getSubPolygon(int subPolyIndex)
     {
         if(subPolygons.size() > 0 && subPolyIndex < (int)subPolygons.size())
             return subPolygons[subPolyIndex];
@@ -567,27 +3788,202 @@ public:
         return subPolygons.size();
     }
 
-    void returnLowestLevelPolys(std::vector<ConcavePolygon > & returnArr)
+    BoundingBox const & getBounds() const
+    {
+        return bounds;
+    }
+
+    // The segment this node was sliced along. Only meaningful when
+    // getNumberSubPolys() > 0; leaves return a zero length segment.
+    LineSegment const & getCut() const
+    {
+        return cut;
+    }
+
+    // Frees the vertex and reflex arrays of every node that has sub
+    // polygons, leaving only the leaves' vertices, the cuts and the
+    // bounds. Leaf queries and further slicing work as before, but
+    // getVertices on an interior node returns an empty array afterwards
+    // and reset can no longer bring the original polygon back.
+    void compact()
     {
-        if(subPolygons.size() > 0)
+        Array<BasicConcavePolygon * > pending(1, this, getAllocator());
+
+        while(pending.size() > 0)
         {
-            subPolygons[0].returnLowestLevelPolys(returnArr);
-            subPolygons[1].returnLowestLevelPolys(returnArr);
+            BasicConcavePolygon * node = pending.back();
+            pending.pop_back();
+
+            if(node->subPolygons.size() > 0)
+            {
+                node->releaseVertices();
+                pending.push_back(&node->subPolygons[1]);
+                pending.push_back(&node->subPolygons[0]);
+            }
         }
-        else
-            returnArr.push_back(*this);
     }
 
-    void reset()
+    // Folds the bounds of every node below this one back into their
+    // ancestors. Slicing and decomposing through this polygon keep the
+    // bounds current; call this after changing a sub polygon obtained
+    // from getSubPolygon directly.
+    void updateBounds()
+    {
+        Array<BasicConcavePolygon * > nodes(1, this, getAllocator());
+
+        // Parents come before their children, so walking the list
+        // backwards visits every child before its parent
+        for(unsigned int i=0; i<nodes.size(); ++i)
+            for(unsigned int k=0; k<nodes[i]->subPolygons.size(); ++k)
+                nodes.push_back(&nodes[i]->subPolygons[k]);
+
+        for(unsigned int i=nodes.size(); i-- > 0; )
+            for(unsigned int k=0; k<nodes[i]->subPolygons.size(); ++k)
+                nodes[i]->bounds.expand(nodes[i]->subPolygons[k].bounds);
+    }
+
+    // Forward iterator over the leaves below a node in the same order as
+    // returnLowestLevelPolys. Dereferencing gives a view of the leaf's
+    // vertices, so nothing is copied; the view is invalidated by slicing
+    // or decomposing the tree further.
+    class LeafIterator
+    {
+        Array<BasicConcavePolygon const * > pending;
+
+        void descend()
+        {
+            while(pending.size() > 0 && pending.back()->subPolygons.size() > 0)
+            {
+                BasicConcavePolygon const * node = pending.back();
+                pending.pop_back();
+                pending.push_back(&node->subPolygons[1]);
+                pending.push_back(&node->subPolygons[0]);
+            }
+        }
+
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef VertexSpan value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef VertexSpan const * pointer;
+        typedef VertexSpan reference;
+
+        LeafIterator() {}
+        explicit LeafIterator(BasicConcavePolygon const * root) :
+            pending(1, root, root->getAllocator())
+        {
+            descend();
+        }
+
+        VertexSpan operator * () const
+        {
+            return VertexSpan(pending.back()->vertices);
+        }
+
+        BasicConcavePolygon const & getPolygon() const
+        {
+            return *pending.back();
+        }
+
+        LeafIterator & operator ++ ()
+        {
+            pending.pop_back();
+            descend();
+            return *this;
+        }
+
+        bool operator == (LeafIterator const & other) const
+        {
+            if(pending.size() == 0 || other.pending.size() == 0)
+                return pending.size() == other.pending.size();
+
+            return pending.size() == other.pending.size() &&
+                   pending.back() == other.pending.back();
+        }
+
+        bool operator != (LeafIterator const & other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    struct LeafRange
+    {
+        BasicConcavePolygon const * root;
+
+        LeafIterator begin() const { return LeafIterator(root); }
+        LeafIterator end() const { return LeafIterator(); }
+    };
+
+    LeafRange leaves() const
+    {
+        return {this};
+    }
+
+    // Calls visit(VertexSpan) for every leaf below this polygon, in the
+    // same order as returnLowestLevelPolys, without copying any vertices.
+    template<typename Visitor>
+    void forEachLeaf(Visitor const & visit) const
     {
-        if(subPolygons.size() > 0)
+        Array<BasicConcavePolygon const * > pending(1, this, getAllocator());
+
+        while(pending.size() > 0)
+        {
+            BasicConcavePolygon const * node = pending.back();
+            pending.pop_back();
+
+            if(node->subPolygons.size() > 0)
+            {
+                pending.push_back(&node->subPolygons[1]);
+                pending.push_back(&node->subPolygons[0]);
+            }
+            else
+                visit(VertexSpan(node->vertices));
+        }
+    }
+
+    // Appends a copy of every leaf below this polygon to returnArr, each
+    // with its own vertex array. Kept for existing callers: forEachLeaf
+    // or the ConvexDecomposition overload give the same pieces without a
+    // copy or an allocation per leaf.
+    void returnLowestLevelPolys(std::vector<BasicConcavePolygon > & returnArr) const
+    {
+        Array<BasicConcavePolygon const * > pending(1, this, getAllocator());
+
+        while(pending.size() > 0)
         {
-            subPolygons[0].reset();
-            subPolygons[1].reset();
-            subPolygons.clear();
+            BasicConcavePolygon const * node = pending.back();
+            pending.pop_back();
+
+            if(node->subPolygons.size() > 0)
+            {
+                pending.push_back(&node->subPolygons[1]);
+                pending.push_back(&node->subPolygons[0]);
+            }
+            else
+                returnArr.push_back(*node);
         }
     }
 
+    void returnLowestLevelPolys(ConvexDecomposition & result) const
+    {
+        result.clear();
+        appendLowestLevelPolys(result);
+    }
+
+    void returnLowestLevelPolys(PhysicsDecomposition & result) const
+    {
+        result.clear();
+        appendLowestLevelPolys(result);
+    }
+
+    void reset()
+    {
+        subPolygons.clear();
+        cut = LineSegment(Vec2{}, Vec2{});
+        bounds = BoundingBox::aroundEdges(vertices);
+    }
+
     Vec2 getPoint(unsigned int index) const
     {
         if(index >= 0 && index < vertices.size())
@@ -602,6 +3998,24 @@ public:
     }
 };
 
+typedef BasicConcavePolygon<double> ConcavePolygon;
+typedef BasicConcavePolygon<float> ConcavePolygonf;
+
+#ifdef CXD_HAS_PMR
+// Polygons whose storage comes from a std::pmr::memory_resource, e.g. a
+// std::pmr::monotonic_buffer_resource released after each job
+namespace pmr
+{
+
+template<typename Scalar>
+using BasicConcavePolygon = cxd::BasicConcavePolygon<Scalar, std::pmr::polymorphic_allocator<BasicVertex<Scalar> > >;
+
+typedef BasicConcavePolygon<double> ConcavePolygon;
+typedef BasicConcavePolygon<float> ConcavePolygonf;
+
+}
+#endif
+
 }
 
 #endif // CONCAVE_POLY_H
@@ -0,0 +1,262 @@
+#ifndef CXD_DECOMPOSITION_CACHE_H
+#define CXD_DECOMPOSITION_CACHE_H
+
+#include "ConcavePolygon.h"
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+
+namespace cxd
+{
+
+// Remembers the decompositions of recently seen shapes, so polygons that
+// repeat across a level, translated or not, are only decomposed once.
+// A shape is its vertex array relative to its first vertex: two polygons
+// match when those relative coordinates are equal, and the cached pieces
+// are translated back onto the first vertex of the polygon asked for.
+// Every shape is decomposed at that origin, so a polygon gets the same
+// pieces whether or not it was a hit, whichever instance came first.
+// Translating by a value that is not a multiple of the coordinates' own
+// precision rounds the relative coordinates differently; a positive
+// tolerance lets coordinates that differ by at most that much match, in
+// which case the pieces are those of the instance seen first.
+// At most capacity shapes are kept, dropping the least recently used.
+// decompose may be called from several threads at once; the lock is only
+// held to look shapes up, and decomposition and copying happen outside it.
+template<typename Scalar>
+class BasicDecompositionCache
+{
+    typedef BasicVec2<Scalar> Vec2;
+    typedef BasicVertex<Scalar> Vertex;
+    typedef BasicVertexSpan<Scalar> VertexSpan;
+    typedef BasicConvexDecomposition<Scalar> ConvexDecomposition;
+
+    struct Entry
+    {
+        std::uint64_t hash;
+        std::vector<Vertex > shape;
+        std::shared_ptr<ConvexDecomposition const> pieces;
+    };
+
+    typedef std::list<Entry > EntryList;
+
+    // Most recently used first
+    EntryList entries;
+    std::unordered_multimap<std::uint64_t, typename EntryList::iterator> lookup;
+
+    std::size_t capacity;
+    DecompOptions options;
+    Scalar tolerance;
+
+    std::size_t hits;
+    std::size_t misses;
+
+    mutable std::mutex mutex;
+
+    Scalar toKey(Scalar coordinate) const
+    {
+        if(tolerance > 0.0f)
+            coordinate = std::round(coordinate / tolerance);
+
+        // -0 and 0 compare equal
+        return coordinate == 0.0f ? Scalar(0) : coordinate;
+    }
+
+    // FNV-1a over the bits of the coordinates relative to origin, rounded
+    // to the tolerance. Coordinates within tolerance of each other can
+    // still round apart, which only costs a miss.
+    std::uint64_t hashShape(VertexSpan vertices, Vec2 const & origin) const
+    {
+        std::uint64_t hash = 14695981039346656037ull;
+
+        for(auto const & vertex : vertices)
+        {
+            Vec2 relative = vertex.position - origin;
+            Scalar coordinates[2] = {toKey(relative.x), toKey(relative.y)};
+            unsigned char bytes[sizeof(coordinates)];
+            std::memcpy(bytes, coordinates, sizeof(coordinates));
+
+            for(unsigned char byte : bytes)
+            {
+                hash ^= byte;
+                hash *= 1099511628211ull;
+            }
+        }
+
+        return hash;
+    }
+
+    bool isSameShape(std::vector<Vertex > const & shape, VertexSpan vertices, Vec2 const & origin) const
+    {
+        if(shape.size() != vertices.size())
+            return false;
+
+        for(unsigned int i=0; i<shape.size(); ++i)
+        {
+            Vec2 relative = vertices[i].position - origin;
+            if(!(std::abs(shape[i].position.x - relative.x) <= tolerance &&
+                 std::abs(shape[i].position.y - relative.y) <= tolerance))
+                return false;
+        }
+
+        return true;
+    }
+
+    // Returns the cached pieces of the shape, or nullptr, and marks them
+    // as the most recently used. The caller holds the lock.
+    std::shared_ptr<ConvexDecomposition const> find(std::uint64_t hash,
+                                                    VertexSpan vertices,
+                                                    Vec2 const & origin)
+    {
+        auto range = lookup.equal_range(hash);
+
+        for(auto it = range.first; it != range.second; ++it)
+        {
+            if(isSameShape(it->second->shape, vertices, origin))
+            {
+                entries.splice(entries.begin(), entries, it->second);
+                return it->second->pieces;
+            }
+        }
+
+        return nullptr;
+    }
+
+    static void translate(ConvexDecomposition const & pieces,
+                          Vec2 const & offset,
+                          ConvexDecomposition & result)
+    {
+        result.vertices.resize(pieces.vertices.size());
+        result.pieces = pieces.pieces;
+
+        for(unsigned int i=0; i<pieces.vertices.size(); ++i)
+        {
+            result.vertices[i] = pieces.vertices[i];
+            result.vertices[i].position = pieces.vertices[i].position + offset;
+        }
+    }
+
+public:
+    explicit BasicDecompositionCache(std::size_t _capacity,
+                                     DecompOptions const & _options = DecompOptions(),
+                                     Scalar _tolerance = 0.0f) :
+        capacity{_capacity}, options(_options), tolerance{_tolerance}, hits{0}, misses{0} {}
+
+    BasicDecompositionCache(BasicDecompositionCache const &) = delete;
+    BasicDecompositionCache & operator = (BasicDecompositionCache const &) = delete;
+
+    // Fills result with the convex pieces of the polygon with these
+    // vertices and returns true if they came from the cache.
+    bool decompose(VertexSpan vertices, ConvexDecomposition & result)
+    {
+        result.clear();
+
+        if(vertices.empty())
+            return false;
+
+        Vec2 origin = vertices[0].position;
+        std::uint64_t hash = hashShape(vertices, origin);
+        std::shared_ptr<ConvexDecomposition const> pieces;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pieces = find(hash, vertices, origin);
+
+            if(pieces)
+                ++hits;
+            else
+                ++misses;
+        }
+
+        if(pieces)
+        {
+            translate(*pieces, origin, result);
+            return true;
+        }
+
+        std::vector<Vertex > shape(vertices.begin(), vertices.end());
+        for(auto & vertex : shape)
+            vertex.position = vertex.position - origin;
+
+        std::shared_ptr<ConvexDecomposition> decomposed = std::make_shared<ConvexDecomposition>();
+        VertexSpan shapeVertices(shape);
+        BasicConcavePolygon<Scalar> polygon(shapeVertices);
+        polygon.convexDecomp(*decomposed, options);
+
+        translate(*decomposed, origin, result);
+
+        if(capacity == 0)
+            return false;
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        // Another thread may have decomposed the same shape meanwhile
+        if(find(hash, vertices, origin))
+            return false;
+
+        entries.push_front(Entry());
+        entries.front().hash = hash;
+        entries.front().shape.swap(shape);
+        entries.front().pieces = decomposed;
+        lookup.insert(std::make_pair(hash, entries.begin()));
+
+        while(entries.size() > capacity)
+        {
+            auto range = lookup.equal_range(entries.back().hash);
+            for(auto it = range.first; it != range.second; ++it)
+            {
+                if(it->second == std::prev(entries.end()))
+                {
+                    lookup.erase(it);
+                    break;
+                }
+            }
+            entries.pop_back();
+        }
+
+        return false;
+    }
+
+    bool decompose(std::vector<Vertex > const & vertices, ConvexDecomposition & result)
+    {
+        return decompose(VertexSpan(vertices), result);
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        lookup.clear();
+        hits = 0;
+        misses = 0;
+    }
+
+    std::size_t getNumberShapes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.size();
+    }
+
+    std::size_t getNumberHits() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hits;
+    }
+
+    std::size_t getNumberMisses() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return misses;
+    }
+};
+
+typedef BasicDecompositionCache<double> DecompositionCache;
+typedef BasicDecompositionCache<float> DecompositionCachef;
+
+}
+
+#endif // CXD_DECOMPOSITION_CACHE_H
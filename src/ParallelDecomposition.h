@@ -0,0 +1,173 @@
+#ifndef CXD_PARALLEL_DECOMPOSITION_H
+#define CXD_PARALLEL_DECOMPOSITION_H
+
+#include "ConcavePolygon.h"
+#include "ThreadPool.h"
+
+namespace cxd
+{
+
+namespace detail
+{
+
+// Collects the counters of pool tasks, which run on other threads than the
+// caller's StatsScope, and hands the total back to the caller's sink.
+class TaskStatsCollector
+{
+#ifdef CXD_ENABLE_STATS
+    std::mutex mutex;
+    DecompStats total;
+#endif
+
+public:
+    template<typename Body>
+    void run(Body const & body)
+    {
+#ifdef CXD_ENABLE_STATS
+        DecompStats taskStats;
+        {
+            StatsScope scope(taskStats);
+            body();
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        total.merge(taskStats);
+#else
+        body();
+#endif
+    }
+
+    void publish()
+    {
+#ifdef CXD_ENABLE_STATS
+        if(DecompStats * stats = activeStats())
+            stats->merge(total);
+#endif
+    }
+};
+
+}
+
+// Decomposes every polygon independently on the pool. results[i] always
+// holds the pieces of polygons[i], so the output does not depend on the
+// number of threads or on scheduling.
+template<typename Scalar, typename Allocator>
+void decomposeBatch(Span<BasicConcavePolygon<Scalar, Allocator> const> polygons,
+                    std::vector<BasicConvexDecomposition<Scalar> > & results,
+                    ThreadPool & pool,
+                    DecompOptions const & options = DecompOptions())
+{
+    CXD_STATS_SCOPE();
+    detail::TaskStatsCollector taskStats;
+
+    results.resize(polygons.size());
+
+    std::size_t numChunks = (std::size_t)pool.getNumberThreads() * 8;
+    std::size_t grainSize = (polygons.size() + numChunks - 1) / numChunks;
+
+    pool.parallelFor(polygons.size(), grainSize,
+                     [&polygons, &results, &options, &taskStats](std::size_t begin, std::size_t end)
+    {
+        taskStats.run([&]()
+        {
+            for(std::size_t i=begin; i<end; ++i)
+                polygons[i].convexDecomp(results[i], options);
+        });
+    });
+
+    taskStats.publish();
+}
+
+template<typename Scalar, typename Allocator>
+void decomposeBatch(std::vector<BasicConcavePolygon<Scalar, Allocator> > const & polygons,
+                    std::vector<BasicConvexDecomposition<Scalar> > & results,
+                    ThreadPool & pool,
+                    DecompOptions const & options = DecompOptions())
+{
+    decomposeBatch(Span<BasicConcavePolygon<Scalar, Allocator> const>(polygons), results, pool, options);
+}
+
+template<typename Scalar, typename Allocator>
+std::vector<BasicConvexDecomposition<Scalar> > decomposeBatch(Span<BasicConcavePolygon<Scalar, Allocator> const> polygons,
+                                                              unsigned int numThreads = 0,
+                                                              DecompOptions const & options = DecompOptions())
+{
+    std::vector<BasicConvexDecomposition<Scalar> > results;
+    ThreadPool pool(numThreads);
+    decomposeBatch(polygons, results, pool, options);
+    return results;
+}
+
+template<typename Scalar, typename Allocator>
+std::vector<BasicConvexDecomposition<Scalar> > decomposeBatch(std::vector<BasicConcavePolygon<Scalar, Allocator> > const & polygons,
+                                                              unsigned int numThreads = 0,
+                                                              DecompOptions const & options = DecompOptions())
+{
+    return decomposeBatch(Span<BasicConcavePolygon<Scalar, Allocator> const>(polygons), numThreads, options);
+}
+
+// Opt-in parallel decomposition of a single large polygon. The two halves
+// produced by every slice are independent, so one is handed to the pool
+// while the current task carries on with the other. Nodes with fewer than
+// sequentialCutoff vertices are finished sequentially by one task.
+template<typename Scalar, typename Allocator>
+void convexDecompParallel(BasicConcavePolygon<Scalar, Allocator> & polygon,
+                          ThreadPool & pool,
+                          int sequentialCutoff = 2048,
+                          DecompOptions const & options = DecompOptions())
+{
+    typedef BasicConcavePolygon<Scalar, Allocator> ConcavePolygon;
+
+    CXD_STATS_SCOPE();
+    detail::TaskStatsCollector taskStats;
+    TaskGroup group;
+
+    std::function<void(ConcavePolygon &)> decompose = [&](ConcavePolygon & node)
+    {
+        ConcavePolygon * current = &node;
+
+        while(true)
+        {
+            if(current->getPointCount() < sequentialCutoff)
+            {
+                current->convexDecomp(options);
+                return;
+            }
+
+            if(current->convexDecompStep(options) == false)
+                return;
+
+            ConcavePolygon * other = &current->getSubPolygon(1);
+            pool.submit(group, [&decompose, &taskStats, other]()
+            {
+                taskStats.run([&]()
+                {
+                    decompose(*other);
+                });
+            });
+
+            current = &current->getSubPolygon(0);
+        }
+    };
+
+    decompose(polygon);
+    pool.wait(group);
+
+    // Tasks only fold pieces into the nodes they sliced
+    polygon.updateBounds();
+
+    taskStats.publish();
+}
+
+template<typename Scalar, typename Allocator>
+void convexDecompParallel(BasicConcavePolygon<Scalar, Allocator> & polygon,
+                          unsigned int numThreads = 0,
+                          int sequentialCutoff = 2048,
+                          DecompOptions const & options = DecompOptions())
+{
+    ThreadPool pool(numThreads);
+    convexDecompParallel(polygon, pool, sequentialCutoff, options);
+}
+
+}
+
+#endif // CXD_PARALLEL_DECOMPOSITION_H
@@ -0,0 +1,276 @@
+#ifndef CXD_THREAD_POOL_H
+#define CXD_THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+namespace cxd
+{
+
+// Counts the outstanding tasks of one parallel job so that a caller can
+// wait for exactly that job while the pool keeps serving others.
+class TaskGroup
+{
+    friend class ThreadPool;
+
+    std::atomic<int> outstanding;
+
+public:
+    TaskGroup() : outstanding{0} {}
+
+    bool isDone() const
+    {
+        return outstanding.load(std::memory_order_acquire) == 0;
+    }
+};
+
+// Work-stealing pool: every worker owns a deque, pushes and pops its own
+// work at the back and steals from the front of the other deques when it
+// runs dry. Threads waiting on a TaskGroup execute queued tasks instead of
+// blocking, so tasks may safely spawn and wait on nested work.
+class ThreadPool
+{
+    typedef std::function<void()> Task;
+
+    struct QueuedTask
+    {
+        Task task;
+        TaskGroup * group;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<QueuedTask > tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue > > queues;
+    std::vector<std::thread > workers;
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeCondition;
+    std::atomic<int> queuedTasks;
+    std::atomic<unsigned int> nextQueue;
+    bool stopping;
+
+    struct WorkerIdentity
+    {
+        ThreadPool const * pool;
+        int index;
+    };
+
+    static WorkerIdentity & currentWorker()
+    {
+        static thread_local WorkerIdentity identity = {nullptr, -1};
+        return identity;
+    }
+
+    int getWorkerIndex() const
+    {
+        WorkerIdentity const & identity = currentWorker();
+        if(identity.pool == this)
+            return identity.index;
+
+        return -1;
+    }
+
+    bool popTask(int queueIndex, QueuedTask & result)
+    {
+        WorkQueue & queue = *queues[queueIndex];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty())
+            return false;
+
+        result = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    bool stealTask(int queueIndex, QueuedTask & result)
+    {
+        WorkQueue & queue = *queues[queueIndex];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if(!lock.owns_lock() || queue.tasks.empty())
+            return false;
+
+        result = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        queuedTasks.fetch_sub(1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    bool findTask(int ownIndex, QueuedTask & result)
+    {
+        if(queuedTasks.load(std::memory_order_acquire) == 0)
+            return false;
+
+        if(ownIndex >= 0 && popTask(ownIndex, result))
+            return true;
+
+        int numQueues = queues.size();
+        int start = ownIndex >= 0 ? ownIndex + 1 : 0;
+        for(int i=0; i<numQueues; ++i)
+        {
+            int victim = (start + i) % numQueues;
+            if(victim != ownIndex && stealTask(victim, result))
+                return true;
+        }
+
+        // A failed try_lock is not proof the queues are empty
+        for(int i=0; i<numQueues; ++i)
+        {
+            int victim = (start + i) % numQueues;
+            if(victim != ownIndex && popTask(victim, result))
+                return true;
+        }
+
+        return false;
+    }
+
+    void runTask(QueuedTask & queuedTask)
+    {
+        queuedTask.task();
+
+        if(queuedTask.group->outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeCondition.notify_all();
+        }
+    }
+
+    void workerLoop(int index)
+    {
+        currentWorker() = {this, index};
+
+        while(true)
+        {
+            QueuedTask queuedTask;
+            if(findTask(index, queuedTask))
+            {
+                runTask(queuedTask);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeCondition.wait(lock, [this]()
+            {
+                return stopping || queuedTasks.load(std::memory_order_acquire) > 0;
+            });
+
+            if(stopping && queuedTasks.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+
+public:
+    explicit ThreadPool(unsigned int numThreads = 0) : queuedTasks{0},
+        nextQueue{0}, stopping{false}
+    {
+        if(numThreads == 0)
+            numThreads = std::thread::hardware_concurrency();
+        if(numThreads == 0)
+            numThreads = 1;
+
+        for(unsigned int i=0; i<numThreads; ++i)
+            queues.emplace_back(new WorkQueue);
+
+        for(unsigned int i=0; i<numThreads; ++i)
+            workers.emplace_back(&ThreadPool::workerLoop, this, (int)i);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+
+        for(unsigned int i=0; i<workers.size(); ++i)
+            workers[i].join();
+    }
+
+    ThreadPool(ThreadPool const &) = delete;
+    ThreadPool & operator = (ThreadPool const &) = delete;
+
+    int getNumberThreads() const
+    {
+        return workers.size();
+    }
+
+    void submit(TaskGroup & group, Task task)
+    {
+        group.outstanding.fetch_add(1, std::memory_order_relaxed);
+
+        int queueIndex = getWorkerIndex();
+        if(queueIndex < 0)
+            queueIndex = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+        {
+            WorkQueue & queue = *queues[queueIndex];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back({std::move(task), &group});
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            queuedTasks.fetch_add(1, std::memory_order_release);
+        }
+        wakeCondition.notify_one();
+    }
+
+    // Blocks until every task submitted to the group has finished. The
+    // calling thread runs queued tasks while it waits.
+    void wait(TaskGroup & group)
+    {
+        int ownIndex = getWorkerIndex();
+
+        while(!group.isDone())
+        {
+            QueuedTask queuedTask;
+            if(findTask(ownIndex, queuedTask))
+            {
+                runTask(queuedTask);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeCondition.wait(lock, [this, &group]()
+            {
+                return group.isDone() || queuedTasks.load(std::memory_order_acquire) > 0;
+            });
+        }
+    }
+
+    // Runs body(begin, end) over [0, count) split into chunks of at most
+    // grainSize items and waits for all of them.
+    template<typename Body>
+    void parallelFor(std::size_t count, std::size_t grainSize, Body const & body)
+    {
+        if(grainSize == 0)
+            grainSize = 1;
+
+        TaskGroup group;
+        for(std::size_t begin=0; begin<count; begin+=grainSize)
+        {
+            std::size_t end = begin + grainSize < count ? begin + grainSize : count;
+            submit(group, [&body, begin, end]()
+            {
+                body(begin, end);
+            });
+        }
+
+        wait(group);
+    }
+};
+
+}
+
+#endif // CXD_THREAD_POOL_H